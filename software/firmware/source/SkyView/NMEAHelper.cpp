@@ -154,10 +154,12 @@ static void NMEA_Parse_Character(char c)
 
           if (Container[i].ID == fo.ID) {
             Container[i] = fo;
+            Traffic_Rank(i);
             break;
           } else {
             if (now() - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
               Container[i] = fo;
+              Traffic_Rank(i);
               break;
             }
           }
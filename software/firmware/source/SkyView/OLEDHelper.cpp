@@ -137,7 +137,7 @@ void OLED_loop()
 
       if (isTimeToDisplay()) {
 
-        int j=0;
+        int j = Traffic_Ranked;
         uint16_t x = 0;
         uint16_t y = 9;
         char id_str  [9];
@@ -145,18 +145,6 @@ void OLED_loop()
         char brg_str [4];
         char elev_str[6];
 
-        for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-          if (Container[i].ID && (now() - Container[i].timestamp) <= OLED_EXPIRATION_TIME) {
-
-            traffic[j].fop = &Container[i];
-            traffic[j].distance = sqrtf(Container[i].RelativeNorth * Container[i].RelativeNorth +
-                                        Container[i].RelativeEast  * Container[i].RelativeEast);
-            j++;
-          }
-        }
-
-        qsort(traffic, j, sizeof(traffic_by_dist_t), traffic_cmp_by_distance);
-
         odisplay.fillRect(x, y, odisplay.width(), odisplay.height() - y, BLACK);
 
         odisplay.setFont(&Org_01);
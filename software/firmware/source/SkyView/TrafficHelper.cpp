@@ -28,52 +28,104 @@
 
 traffic_t ThisAircraft, Container[MAX_TRACKING_OBJECTS], fo, EmptyFO;
 traffic_by_dist_t traffic[MAX_TRACKING_OBJECTS];
+int Traffic_Ranked = 0;
 
 static unsigned long UpdateTrafficTimeMarker = 0;
 static unsigned long Traffic_Voice_TimeMarker = 0;
 static uint32_t Traffic_Voice_ID_prev = 0;
 
+/* scale factors of the local east-north frame, see ENU.h */
+static enu_anchor_t ENU_Anchor;
+
+static void Traffic_ENU(float lat, float lon, float *east, float *north)
+{
+  ENU_Project(&ENU_Anchor, ThisAircraft.latitude, ThisAircraft.longitude,
+              lat, lon, east, north);
+}
+
 void Traffic_Update(int ndx)
 {
-  float distance = nmea.distanceBetween( ThisAircraft.latitude,
-                                         ThisAircraft.longitude,
-                                         Container[ndx].latitude,
-                                         Container[ndx].longitude);
+  float east, north;
 
-  float bearing  = nmea.courseTo( ThisAircraft.latitude,
-                                  ThisAircraft.longitude,
-                                  Container[ndx].latitude,
-                                  Container[ndx].longitude);
+  Traffic_ENU(Container[ndx].latitude, Container[ndx].longitude, &east, &north);
 
-  float RelativeNorth     = constrain(distance * cos(radians(bearing)),
-                                       -32768, 32767);
-  float RelativeEast      = constrain(distance * sin(radians(bearing)),
-                                       -32768, 32767);
+  float RelativeNorth     = constrain(north, -32768, 32767);
+  float RelativeEast      = constrain(east,  -32768, 32767);
   float RelativeVertical  = constrain(Container[ndx].altitude - ThisAircraft.altitude,
                                        -32768, 32767);
 
   Container[ndx].RelativeNorth    = (int16_t) RelativeNorth;
   Container[ndx].RelativeEast     = (int16_t) RelativeEast;
   Container[ndx].RelativeVertical = (int16_t) RelativeVertical;
+
+  Traffic_Rank(ndx);
 }
 
-static void Traffic_Voice()
+static bool Traffic_Rank_Before(traffic_by_dist_t *a, traffic_by_dist_t *b)
 {
-  int j=0;
-  int bearing;
-  char message[80];
-
-  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-    if (Container[i].ID && (now() - Container[i].timestamp) <= VOICE_EXPIRATION_TIME) {
+  if (a->fop->AlarmLevel != b->fop->AlarmLevel) {
+    return a->fop->AlarmLevel > b->fop->AlarmLevel;
+  }
+  if ((int) a->tcpa != (int) b->tcpa) {
+    return a->tcpa < b->tcpa;
+  }
+  return a->distance < b->distance;
+}
 
-      traffic[j].fop = &Container[i];
-      traffic[j].distance = sqrtf(Container[i].RelativeNorth * Container[i].RelativeNorth +
-                                  Container[i].RelativeEast  * Container[i].RelativeEast);
-      j++;
+/*
+ * Re-position Container[ndx] in traffic[]. An empty slot is just removed.
+ * Costs one pass over traffic[], instead of qsort() by every consumer.
+ */
+void Traffic_Rank(int ndx)
+{
+  traffic_t *fop = &Container[ndx];
+  traffic_by_dist_t entry;
+  int i;
+
+  for (i=0; i < Traffic_Ranked; i++) {
+    if (traffic[i].fop == fop) {
+      memmove(&traffic[i], &traffic[i+1],
+              (Traffic_Ranked - i - 1) * sizeof(traffic_by_dist_t));
+      Traffic_Ranked--;
+      break;
     }
   }
 
-  if (j > 0 && traffic[0].fop->ID != Traffic_Voice_ID_prev) {
+  if (!fop->ID) {
+    return;
+  }
+
+  float north = fop->RelativeNorth;
+  float east  = fop->RelativeEast;
+
+  /* relative velocity, m/s */
+  float vn = fop->GroundSpeed * cosf(radians(fop->Track)) -
+             ThisAircraft.GroundSpeed * cosf(radians(ThisAircraft.Track));
+  float ve = fop->GroundSpeed * sinf(radians(fop->Track)) -
+             ThisAircraft.GroundSpeed * sinf(radians(ThisAircraft.Track));
+  float v2 = vn * vn + ve * ve;
+  float closing = -(north * vn + east * ve);
+
+  entry.fop      = fop;
+  entry.distance = sqrtf(north * north + east * east);
+  entry.tcpa     = (v2 > 0 && closing > 0 && closing < v2 * TRAFFIC_TCPA_NONE) ?
+                   closing / v2 : TRAFFIC_TCPA_NONE;
+
+  for (i = Traffic_Ranked; i > 0 && Traffic_Rank_Before(&entry, &traffic[i-1]); i--) {
+    traffic[i] = traffic[i-1];
+  }
+  traffic[i] = entry;
+  Traffic_Ranked++;
+}
+
+static void Traffic_Voice()
+{
+  int bearing;
+  char message[80];
+
+  if (Traffic_Ranked > 0 &&
+      (now() - traffic[0].fop->timestamp) <= VOICE_EXPIRATION_TIME &&
+      traffic[0].fop->ID != Traffic_Voice_ID_prev) {
 
     const char *u_dist, *u_alt;
     float voc_dist;
@@ -82,8 +134,6 @@ static void Traffic_Voice()
     char how_far[32];
     char elev[32];
 
-    qsort(traffic, j, sizeof(traffic_by_dist_t), traffic_cmp_by_distance);
-
     bearing = (int) (atan2f(traffic[0].fop->RelativeNorth,
                             traffic[0].fop->RelativeEast) * 180.0 / PI);  /* -180 ... 180 */
 
@@ -217,6 +267,7 @@ void Traffic_loop()
             Traffic_Update(i);
         } else {
           Container[i] = EmptyFO;
+          Traffic_Rank(i);
         }
       }
 
@@ -238,6 +289,7 @@ void Traffic_ClearExpired()
   for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
     if (Container[i].ID && (now() - Container[i].timestamp) > ENTRY_EXPIRATION_TIME) {
       Container[i] = EmptyFO;
+      Traffic_Rank(i);
     }
   }
 }
@@ -254,13 +306,3 @@ int Traffic_Count()
 
   return count;
 }
-
-int traffic_cmp_by_distance(const void *a, const void *b)
-{
-  traffic_by_dist_t *ta = (traffic_by_dist_t *)a;
-  traffic_by_dist_t *tb = (traffic_by_dist_t *)b;
-
-  if (ta->distance >  tb->distance) return  1;
-  if (ta->distance == tb->distance) return  0;
-  if (ta->distance <  tb->distance) return -1;
-}
@@ -21,6 +21,8 @@
 
 #include "SoCHelper.h"
 
+#include <ENU.h>
+
 extern "C" {
 #include <gdl90.h>
 }
@@ -54,12 +56,21 @@ typedef struct traffic_struct {
     uint8_t   callsign [GDL90_TRAFFICREPORT_MSG_CALLSIGN_SIZE];
 } traffic_t;
 
+/*
+ * traffic[] keeps the tracked aircraft ranked by relevance: alarm level,
+ * then time to closest approach, then distance. Every change to Container[]
+ * re-positions a single entry, so that the consumers never have to sort.
+ */
 typedef struct traffic_by_dist_struct {
   traffic_t *fop;
   float     distance;
+  float     tcpa;     /* seconds, TRAFFIC_TCPA_NONE unless closing in */
 } traffic_by_dist_t;
 
+#define TRAFFIC_TCPA_NONE       3600
+
 #define ENTRY_EXPIRATION_TIME   5 /* seconds */
+
 #define TRAFFIC_VECTOR_UPDATE_INTERVAL 2 /* seconds */
 #define TRAFFIC_UPDATE_INTERVAL_MS (TRAFFIC_VECTOR_UPDATE_INTERVAL * 1000)
 #define isTimeToUpdateTraffic() (millis() - UpdateTrafficTimeMarker > \
@@ -73,9 +84,10 @@ void Traffic_setup        (void);
 void Traffic_loop         (void);
 void Traffic_ClearExpired (void);
 int  Traffic_Count        (void);
-int traffic_cmp_by_distance(const void *, const void *);
+void Traffic_Rank         (int);
 
 extern traffic_t ThisAircraft, Container[MAX_TRACKING_OBJECTS], fo, EmptyFO;
 extern traffic_by_dist_t traffic[MAX_TRACKING_OBJECTS];
+extern int Traffic_Ranked;
 
 #endif /* TRAFFICHELPER_H */
@@ -245,8 +245,11 @@ static void EPD_Draw_Radar()
   display->firstPage();
   do
   {
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].ID && (now() - Container[i].timestamp) <= EPD_EXPIRATION_TIME) {
+    /* least relevant first, so that the top ranked targets are drawn over */
+    for (int j=Traffic_Ranked - 1; j >= 0; j--) {
+      traffic_t *fop = traffic[j].fop;
+
+      if ((now() - fop->timestamp) <= EPD_EXPIRATION_TIME) {
 
         int16_t rel_x;
         int16_t rel_y;
@@ -254,26 +257,26 @@ static void EPD_Draw_Radar()
         float bearing;
 #if 0
         Serial.print(F(" ID="));
-        Serial.print((Container[i].ID >> 16) & 0xFF, HEX);
-        Serial.print((Container[i].ID >>  8) & 0xFF, HEX);
-        Serial.print((Container[i].ID      ) & 0xFF, HEX);
+        Serial.print((fop->ID >> 16) & 0xFF, HEX);
+        Serial.print((fop->ID >>  8) & 0xFF, HEX);
+        Serial.print((fop->ID      ) & 0xFF, HEX);
         Serial.println();
 
-        Serial.print(F(" RelativeNorth=")); Serial.println(Container[i].RelativeNorth);
-        Serial.print(F(" RelativeEast="));  Serial.println(Container[i].RelativeEast);
+        Serial.print(F(" RelativeNorth=")); Serial.println(fop->RelativeNorth);
+        Serial.print(F(" RelativeEast="));  Serial.println(fop->RelativeEast);
 #endif
         switch (settings->orientation)
         {
         case DIRECTION_NORTH_UP:
-          rel_x = Container[i].RelativeEast;
-          rel_y = Container[i].RelativeNorth;
+          rel_x = fop->RelativeEast;
+          rel_y = fop->RelativeNorth;
           break;
         case DIRECTION_TRACK_UP:
-          distance = sqrtf(Container[i].RelativeNorth * Container[i].RelativeNorth +
-                           Container[i].RelativeEast  * Container[i].RelativeEast);
+          distance = sqrtf(fop->RelativeNorth * fop->RelativeNorth +
+                           fop->RelativeEast  * fop->RelativeEast);
 
-          bearing = atan2f(Container[i].RelativeNorth,
-                           Container[i].RelativeEast) * 180.0 / PI;  /* -180 ... 180 */
+          bearing = atan2f(fop->RelativeNorth,
+                           fop->RelativeEast) * 180.0 / PI;  /* -180 ... 180 */
 
           /* convert from math angle into course relative to north */
           bearing = (bearing <= 90.0 ? 90.0 - bearing :
@@ -294,12 +297,12 @@ static void EPD_Draw_Radar()
         int16_t x = ((int32_t) rel_x * (int32_t) radius) / divider;
         int16_t y = ((int32_t) rel_y * (int32_t) radius) / divider;
 
-        if        (Container[i].RelativeVertical >   EPD_RADAR_V_THRESHOLD) {
+        if        (fop->RelativeVertical >   EPD_RADAR_V_THRESHOLD) {
           display->fillTriangle(radar_center_x + x - 4, radar_center_y - y + 3,
                                 radar_center_x + x    , radar_center_y - y - 5,
                                 radar_center_x + x + 4, radar_center_y - y + 3,
                                 GxEPD_BLACK);
-        } else if (Container[i].RelativeVertical < - EPD_RADAR_V_THRESHOLD) {
+        } else if (fop->RelativeVertical < - EPD_RADAR_V_THRESHOLD) {
           display->fillTriangle(radar_center_x + x - 4, radar_center_y - y - 3,
                                 radar_center_x + x    , radar_center_y - y + 5,
                                 radar_center_x + x + 4, radar_center_y - y - 3,
@@ -0,0 +1,156 @@
+/*
+ * AirtimeHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AirtimeHelper.h"
+#include "RFHelper.h"
+
+/* duty cycle limit in per mille, indexed by RF_BAND_* */
+static const uint16_t Airtime_Duty[] = {
+  [RF_BAND_AUTO] = 10,
+  [RF_BAND_EU]   = 10,    /* ETSI EN 300 220, 868.0-868.6 MHz */
+  [RF_BAND_US]   = 1000,  /* FCC 15.247 frequency hopping */
+  [RF_BAND_AU]   = 1000,
+  [RF_BAND_NZ]   = 10,
+  [RF_BAND_RU]   = 10,
+  [RF_BAND_CN]   = 10,
+  [RF_BAND_UK]   = 100,   /* 869.4-869.65 MHz */
+  [RF_BAND_IN]   = 1000
+};
+
+static uint16_t Airtime_Permille = 10;
+
+static uint32_t Airtime_Bucket[AIRTIME_BUCKETS];
+static uint8_t  Airtime_Head = 0;
+static uint32_t Airtime_Sum = 0;
+static unsigned long Airtime_Bucket_ms = 0;
+
+airtime_stats_t Airtime_Stats;
+
+void Airtime_setup(uint8_t plan)
+{
+  Airtime_Permille = plan < sizeof(Airtime_Duty) / sizeof(Airtime_Duty[0]) ?
+                     Airtime_Duty[plan] : Airtime_Duty[RF_BAND_AUTO];
+}
+
+/* time on air of a packet with 'size' bytes of payload */
+uint32_t Airtime_us(uint8_t protocol, size_t size)
+{
+  const rf_proto_desc_t *rf = RF_Protocol_Desc(protocol);
+
+  if (rf == NULL) {
+    rf = &legacy_proto_desc;
+  }
+
+  if (rf->modulation_type == RF_MODULATION_TYPE_LORA) {
+    /* same coding as sx1276_setvars() selects */
+    rps_t rps = updr2rps(rf->bitrate);
+
+    if (rf->type == RF_PROTOCOL_FANET) {
+      rps = setCr(rps, CR_4_8);
+    }
+
+    return osticks2us(calcAirTime(rps, size));
+  }
+
+  uint32_t bps;
+
+  switch (rf->bitrate)
+  {
+    case RF_BITRATE_38400:    bps = 38400;   break;
+    case RF_BITRATE_1042KBPS: bps = 1041667; break;
+    case RF_BITRATE_100KBPS:
+    default:                  bps = 100000;  break;
+  }
+
+  /* sync words are given as sent, Manchester doubles the rest */
+  uint32_t bytes = size + rf->crc_size;
+
+  if (rf->whitening == RF_WHITENING_MANCHESTER) {
+    bytes *= 2;
+  }
+  bytes += rf->preamble_size + rf->syncword_size;
+
+  return (uint32_t) ((bytes * 8 * 1000000ULL + bps - 1) / bps);
+}
+
+static void Airtime_Expire()
+{
+  unsigned long elapsed = millis() - Airtime_Bucket_ms;
+
+  if (elapsed < AIRTIME_BUCKET_MS) {
+    return;
+  }
+
+  unsigned long steps = elapsed / AIRTIME_BUCKET_MS;
+
+  if (steps >= AIRTIME_BUCKETS) {
+    memset(Airtime_Bucket, 0, sizeof(Airtime_Bucket));
+    Airtime_Sum = 0;
+    Airtime_Bucket_ms = millis();
+    return;
+  }
+
+  while (steps--) {
+    Airtime_Head = (Airtime_Head + 1) % AIRTIME_BUCKETS;
+    Airtime_Sum -= Airtime_Bucket[Airtime_Head];
+    Airtime_Bucket[Airtime_Head] = 0;
+    Airtime_Bucket_ms += AIRTIME_BUCKET_MS;
+  }
+}
+
+uint32_t Airtime_Budget_us()
+{
+  return (uint32_t) (AIRTIME_WINDOW_MS * Airtime_Permille);
+}
+
+uint32_t Airtime_Window_us()
+{
+  Airtime_Expire();
+
+  return Airtime_Sum;
+}
+
+/* does a packet of 'us' fit into what is left of the budget */
+bool Airtime_Permit(uint32_t us)
+{
+  if (Airtime_Permille >= 1000 || Airtime_Window_us() + us <= Airtime_Budget_us()) {
+    return true;
+  }
+
+  Airtime_Stats.deferred++;
+
+  return false;
+}
+
+void Airtime_Add(uint32_t us)
+{
+  Airtime_Expire();
+
+  Airtime_Bucket[Airtime_Head] += us;
+  Airtime_Sum += us;
+  Airtime_Stats.airtime_us += us;
+}
+
+/*
+ * Interval between packets of 'us' that spends the budget evenly:
+ * a sender paced this way runs at the limit, yet never hits it.
+ */
+uint32_t Airtime_Pace_ms(uint32_t us)
+{
+  return us / Airtime_Permille;
+}
@@ -0,0 +1,49 @@
+/*
+ * AirtimeHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AIRTIMEHELPER_H
+#define AIRTIMEHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Transmit airtime of the last hour, against the duty cycle limit
+ * of the frequency plan in use (1% in the 868.0-868.6 MHz sub-band,
+ * 10% at 869.4-869.65 MHz, none for the hopping 915 MHz plans).
+ * The window slides by AIRTIME_BUCKET_MS.
+ */
+#define AIRTIME_WINDOW_MS   3600000UL
+#define AIRTIME_BUCKETS     60
+#define AIRTIME_BUCKET_MS   (AIRTIME_WINDOW_MS / AIRTIME_BUCKETS)
+
+typedef struct airtime_stats_struct {
+  uint32_t airtime_us;  /* transmitted, wraps */
+  uint32_t deferred;    /* packets held back for want of budget */
+} airtime_stats_t;
+
+void     Airtime_setup(uint8_t);
+uint32_t Airtime_us(uint8_t, size_t);
+bool     Airtime_Permit(uint32_t);
+void     Airtime_Add(uint32_t);
+uint32_t Airtime_Pace_ms(uint32_t);
+uint32_t Airtime_Window_us(void);
+uint32_t Airtime_Budget_us(void);
+
+extern airtime_stats_t Airtime_Stats;
+
+#endif /* AIRTIMEHELPER_H */
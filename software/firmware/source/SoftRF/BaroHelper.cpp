@@ -23,6 +23,7 @@
 
 #include "SoCHelper.h"
 #include "BaroHelper.h"
+#include "VarioHelper.h"
 
 barochip_ops_t *baro_chip = NULL;
 
@@ -31,14 +32,10 @@ Adafruit_BMP280 bmp280;
 Adafruit_MPL3115A2 mpl3115a2 = Adafruit_MPL3115A2();
 
 static unsigned long BaroTimeMarker = 0;
-static float prev_pressure_altitude = 0;
-
-#define VS_AVERAGING_FACTOR   4
-static float Baro_VS[VS_AVERAGING_FACTOR];
-static int avg_ndx = 0;
 
 /* 4 baro sensor readings per second */
-#define isTimeToBaro() ((millis() - BaroTimeMarker) > (1000 / VS_AVERAGING_FACTOR))
+#define BARO_INTERVAL_MS  250
+#define isTimeToBaro() ((millis() - BaroTimeMarker) > BARO_INTERVAL_MS)
 
 static bool bmp180_probe()
 {
@@ -182,12 +179,8 @@ byte Baro_setup()
 
     baro_chip->setup();
 
-    prev_pressure_altitude = baro_chip->altitude(1013.25);
     BaroTimeMarker = millis();
-
-    for (int i=0; i<VS_AVERAGING_FACTOR; i++) {
-      Baro_VS[i] = 0;
-    }
+    Vario_Baro(BaroTimeMarker, (int32_t) (baro_chip->altitude(1013.25) * 100));
 
     return baro_chip->type;
 
@@ -203,28 +196,19 @@ void Baro_loop()
 {
   if (baro_chip && isTimeToBaro()) {
 
-    /* Draft of pressure altitude and vertical speed calculation */
-    ThisAircraft.pressure_altitude = baro_chip->altitude(1013.25);
+    BaroTimeMarker = millis();
 
-    Baro_VS[avg_ndx] = (ThisAircraft.pressure_altitude - prev_pressure_altitude) /
-      (millis() - BaroTimeMarker) * 1000;  /* in m/s */
+    /* pressure altitude and vertical speed are filtered, see VarioHelper */
+    Vario_Baro(BaroTimeMarker, (int32_t) (baro_chip->altitude(1013.25) * 100));
 
-    ThisAircraft.vs = 0;
-    for (int i=0; i<VS_AVERAGING_FACTOR; i++) {
-      ThisAircraft.vs += Baro_VS[i];
-    }
-    ThisAircraft.vs /= VS_AVERAGING_FACTOR;
+    ThisAircraft.pressure_altitude = Vario.altitude / 100.0;
 
-    if (ThisAircraft.vs > -0.1 && ThisAircraft.vs < 0.1) {
+    if (Vario.climb > -VARIO_DEADBAND && Vario.climb < VARIO_DEADBAND) {
       ThisAircraft.vs = 0;
+    } else {
+      ThisAircraft.vs = cms_to_fpm(Vario.climb);
     }
 
-    ThisAircraft.vs *= (_GPS_FEET_PER_METER * 60.0) ; /* feet per minute */
-
-    prev_pressure_altitude = ThisAircraft.pressure_altitude;
-    BaroTimeMarker = millis();
-    avg_ndx = (avg_ndx + 1) % VS_AVERAGING_FACTOR;
-
 #if 0
     Serial.print(F("P.Alt. = ")); Serial.print(ThisAircraft.pressure_altitude);
     Serial.print(F(" , VS avg. = ")); Serial.println(ThisAircraft.vs);
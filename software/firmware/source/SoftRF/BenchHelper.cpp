@@ -0,0 +1,818 @@
+/*
+ * BenchHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(RASPBERRY_PI)
+
+#include <time.h>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+
+#include "BenchHelper.h"
+#include "EEPROMHelper.h"
+#include "TrafficHelper.h"
+#include "JSONHelper.h"
+#include "RFHelper.h"
+#include "Protocol_Legacy.h"
+#include "VarioHelper.h"
+
+static volatile size_t Bench_Sink;  /* keeps the results alive */
+
+static uint64_t Bench_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* ns per call of fn, best of BENCH_ROUNDS */
+static double Bench_Time(size_t (*fn)(void))
+{
+  double best = 0;
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64_t start = Bench_ns();
+    uint64_t elapsed;
+    unsigned long calls = 0;
+
+    do {
+      Bench_Sink += fn();
+      calls++;
+      elapsed = Bench_ns() - start;
+    } while (elapsed < BENCH_ROUND_NS);
+
+    double ns = (double) elapsed / calls;
+
+    if (r == 0 || ns < best) {
+      best = ns;
+    }
+  }
+
+  return best;
+}
+
+/* n gliders within 5 km of own-ship, as the exports see them */
+static void Bench_Traffic(int n)
+{
+  time_t timestamp = now();
+
+  ThisAircraft.latitude  = 56.0;
+  ThisAircraft.longitude = 38.0;
+  ThisAircraft.altitude  = 300;
+  ThisAircraft.timestamp = timestamp;
+
+  for (int i = 0; i < MAX_TRACKING_OBJECTS; i++) {
+    Container[i] = EmptyFO;
+
+    if (i < n) {
+      Container[i].addr          = 0xDD0000 + i;
+      Container[i].protocol      = RF_PROTOCOL_LEGACY;
+      Container[i].aircraft_type = AIRCRAFT_TYPE_GLIDER;
+      Container[i].latitude      = 56.0 + 0.01 * (i - n / 2);
+      Container[i].longitude     = 38.0 - 0.013 * (i - n / 2);
+      Container[i].altitude      = 1000 + 37 * i;
+      Container[i].course        = (45 * i) % 360;
+      Container[i].speed         = 45 + i;
+      Container[i].vs            = -150 + 50 * i;
+      Container[i].timestamp     = timestamp;
+      Container[i].distance      = 1000 + 500 * i;
+    }
+  }
+}
+
+/*
+ * CBOR against PingStation JSON, both ways.
+ * The CBOR decoder below is for the fixed schema only, as a consumer
+ * of the export would have it.
+ */
+static uint8_t Bench_CBOR_Buf[CBOR_BUFFER_SIZE];
+static size_t  Bench_CBOR_Size;
+static char    Bench_PING_Buf[PING_BUFFER_SIZE];
+static size_t  Bench_PING_Size;
+static int64_t Bench_Fields[BENCH_TARGETS][CBOR_AIRCRAFT_FIELDS];
+
+static size_t Bench_CBOR_Encode()
+{
+  return CBOR_Encode(Bench_CBOR_Buf);
+}
+
+static size_t Bench_PING_Encode()
+{
+  return PING_Encode(Bench_PING_Buf, sizeof(Bench_PING_Buf));
+}
+
+static const uint8_t *cbor_get(const uint8_t *p, uint8_t *major, uint64_t *val)
+{
+  uint8_t info = *p & 0x1F;
+
+  *major = *p++ >> 5;
+
+  if (info < 24) {
+    *val = info;
+  } else {
+    *val = 0;
+    for (int n = 1 << (info - 24); n > 0; n--) {
+      *val = (*val << 8) | *p++;
+    }
+  }
+
+  return p;
+}
+
+static size_t Bench_CBOR_Decode()
+{
+  const uint8_t *p = Bench_CBOR_Buf;
+  uint8_t major;
+  uint64_t val;
+  size_t count = 0;
+
+  p = cbor_get(p, &major, &val);      /* [ version, timestamp, [_ ... ] ] */
+  p = cbor_get(p, &major, &val);
+  p = cbor_get(p, &major, &val);
+  p++;                                /* indefinite-length array */
+
+  while (*p != 0xFF && count < BENCH_TARGETS) {
+    p = cbor_get(p, &major, &val);
+
+    for (int f = 0; f < CBOR_AIRCRAFT_FIELDS; f++) {
+      p = cbor_get(p, &major, &val);
+      Bench_Fields[count][f] = major == 1 ? -1 - (int64_t) val : (int64_t) val;
+    }
+    count++;
+  }
+
+  return count;
+}
+
+static size_t Bench_PING_Decode()
+{
+  JsonObject& root = jsonBuffer.parseObject((const char *) Bench_PING_Buf);
+  JsonArray& aircraft = root["aircraft"];
+  size_t count = 0;
+
+  for (JsonArray::iterator it = aircraft.begin();
+       it != aircraft.end() && count < BENCH_TARGETS; ++it, count++) {
+    JsonObject& aircraft_obj = *it;
+
+    Bench_Fields[count][0] = strtol(aircraft_obj["icaoAddress"], NULL, 16);
+    Bench_Fields[count][4] = deg_to_deg7(aircraft_obj["latDD"].as<float>());
+    Bench_Fields[count][5] = deg_to_deg7(aircraft_obj["lonDD"].as<float>());
+    Bench_Fields[count][6] = aircraft_obj["altitudeMM"].as<long>();
+    Bench_Fields[count][7] = aircraft_obj["headingDE2"].as<int>();
+    Bench_Fields[count][8] = aircraft_obj["horVelocityCMS"].as<long>();
+    Bench_Fields[count][9] = aircraft_obj["verVelocityCMS"].as<long>();
+  }
+
+  jsonBuffer.clear();
+
+  return count;
+}
+
+static void Bench_CBOR(const char *arg)
+{
+  Bench_Traffic(BENCH_TARGETS);
+  settings->export_delta = false;
+
+  Bench_CBOR_Size = Bench_CBOR_Encode();
+  Bench_PING_Size = Bench_PING_Encode();
+  Bench_PING_Buf[Bench_PING_Size - 1] = 0;
+
+  /* what goes out must come back */
+  if (Bench_CBOR_Decode() != BENCH_TARGETS ||
+      Bench_Fields[1][0] != Container[1].addr ||
+      Bench_Fields[1][4] != deg_to_deg7(Container[1].latitude)) {
+    fprintf( stderr, "cbor: round trip failed\n" );
+    return;
+  }
+
+  double cbor_enc = Bench_Time(Bench_CBOR_Encode);
+  double ping_enc = Bench_Time(Bench_PING_Encode);
+  double cbor_dec = Bench_Time(Bench_CBOR_Decode);
+  double ping_dec = Bench_Time(Bench_PING_Decode);
+
+  printf("cbor: %d aircraft per report, ns per report\n", BENCH_TARGETS);
+  printf("  %-12s %10s %10s %8s\n", "", "encode", "decode", "bytes");
+  printf("  %-12s %10.0f %10.0f %8u\n", "json (ping)", ping_enc, ping_dec,
+         (unsigned int) Bench_PING_Size);
+  printf("  %-12s %10.0f %10.0f %8u\n", "cbor", cbor_enc, cbor_dec,
+         (unsigned int) Bench_CBOR_Size);
+}
+
+/*
+ * Distance and bearing to every target: the local east-north frame
+ * against the double precision great circle of TinyGPS++.
+ * With -mfloat-abi=soft on ARM the same bench gives the soft-float figures.
+ */
+static float Bench_Distance[BENCH_TARGETS];
+static float Bench_Bearing[BENCH_TARGETS];
+
+static size_t Bench_ENU()
+{
+  static enu_anchor_t anchor;
+
+  for (int i = 0; i < BENCH_TARGETS; i++) {
+    float east, north;
+
+    ENU_Project(&anchor, ThisAircraft.latitude, ThisAircraft.longitude,
+                Container[i].latitude, Container[i].longitude, &east, &north);
+    Bench_Distance[i] = sqrtf(east * east + north * north);
+    Bench_Bearing[i]  = degrees(atan2f(east, north));
+  }
+
+  return BENCH_TARGETS;
+}
+
+static size_t Bench_Great_Circle()
+{
+  for (int i = 0; i < BENCH_TARGETS; i++) {
+    Bench_Distance[i] = TinyGPSPlus::distanceBetween(
+                          ThisAircraft.latitude, ThisAircraft.longitude,
+                          Container[i].latitude, Container[i].longitude);
+    Bench_Bearing[i]  = TinyGPSPlus::courseTo(
+                          ThisAircraft.latitude, ThisAircraft.longitude,
+                          Container[i].latitude, Container[i].longitude);
+  }
+
+  return BENCH_TARGETS;
+}
+
+static void Bench_ENU_Frame(const char *arg)
+{
+  float distance[BENCH_TARGETS];
+  float error = 0;
+
+  Bench_Traffic(BENCH_TARGETS);
+
+  Bench_Great_Circle();
+  memcpy(distance, Bench_Distance, sizeof(distance));
+  Bench_ENU();
+  for (int i = 0; i < BENCH_TARGETS; i++) {
+    error = fmaxf(error, fabsf(Bench_Distance[i] - distance[i]));
+  }
+
+  double enu = Bench_Time(Bench_ENU) / BENCH_TARGETS;
+  double gc  = Bench_Time(Bench_Great_Circle) / BENCH_TARGETS;
+
+#if defined(__SOFTFP__)
+  printf("enu: ns per target, soft-float\n");
+#else
+  printf("enu: ns per target, hard-float\n");
+#endif
+  printf("  %-12s %10.0f\n", "great circle", gc);
+  printf("  %-12s %10.0f   %.1fx, %.2f m off at most within %.0f m\n", "east-north",
+         enu, gc / enu, error, distance[BENCH_TARGETS - 1]);
+}
+
+/*
+ * Per target cost of the tracker and what follows it: a packet is
+ * measured and ranked by Traffic_Update(), in between all of the targets
+ * are dead-reckoned by Traffic_UpdateAll(), with the Legacy alarm on.
+ */
+static size_t Bench_Track_Packet()
+{
+  for (int i = 0; i < BENCH_TARGETS; i++) {
+    Traffic_Update(i);
+  }
+
+  return BENCH_TARGETS;
+}
+
+static size_t Bench_Track_Predict()
+{
+  Traffic_UpdateAll();
+
+  return BENCH_TARGETS;
+}
+
+static void Bench_Track(const char *arg)
+{
+  Bench_Traffic(BENCH_TARGETS);
+  settings->alarm = TRAFFIC_ALARM_LEGACY;
+  Traffic_setup();
+
+  /* start every tracker off */
+  Bench_Track_Packet();
+
+  double packet  = Bench_Time(Bench_Track_Packet) / BENCH_TARGETS;
+  double predict = Bench_Time(Bench_Track_Predict) / BENCH_TARGETS;
+
+  printf("track: ns per target\n");
+  printf("  %-12s %10.0f\n", "packet", packet);
+  printf("  %-12s %10.0f\n", "prediction", predict);
+}
+
+/*
+ * Traffic_Geometry() over structure-of-arrays against the same math done
+ * one ufo_t at a time, for 8 (BENCH_TARGETS), 64 and 1024 targets
+ */
+#define BENCH_BATCH_MAX 1024
+
+static float  Bench_Dlat[BENCH_BATCH_MAX], Bench_Dlon[BENCH_BATCH_MAX];
+static float  Bench_Dalt[BENCH_BATCH_MAX];
+static float  Bench_North[BENCH_BATCH_MAX], Bench_East[BENCH_BATCH_MAX];
+static float  Bench_Dist[BENCH_BATCH_MAX], Bench_Bear[BENCH_BATCH_MAX];
+static int8_t Bench_Alarm[BENCH_BATCH_MAX];
+static ufo_t  Bench_UFO[BENCH_BATCH_MAX];
+
+static traffic_hot_t Bench_Hot = {
+  0, Bench_Dlat, Bench_Dlon, Bench_Dalt, Bench_North, Bench_East,
+  Bench_Dist, Bench_Bear, Bench_Alarm
+};
+
+static size_t Bench_Batch_SoA()
+{
+  Traffic_Geometry(&Bench_Hot);
+
+  return Bench_Hot.count;
+}
+
+static size_t Bench_Batch_AoS()
+{
+  static enu_anchor_t anchor;
+
+  for (int i = 0; i < Bench_Hot.count; i++) {
+    ufo_t *fop = &Bench_UFO[i];
+    float east, north;
+
+    ENU_Project(&anchor, ThisAircraft.latitude, ThisAircraft.longitude,
+                fop->latitude, fop->longitude, &east, &north);
+
+    float d = sqrtf(east * east + north * north);
+    float bearing = degrees(atan2f(east, north));
+
+    fop->distance = d;
+    fop->bearing  = bearing < 0 ? bearing + 360.0f : bearing;
+
+    if (fabsf(fop->altitude - ThisAircraft.altitude) >= VERTICAL_SEPARATION) {
+      fop->alarm_level = ALARM_LEVEL_NONE;
+    } else if (d < ALARM_ZONE_URGENT) {
+      fop->alarm_level = ALARM_LEVEL_URGENT;
+    } else if (d < ALARM_ZONE_IMPORTANT) {
+      fop->alarm_level = ALARM_LEVEL_IMPORTANT;
+    } else if (d < ALARM_ZONE_LOW) {
+      fop->alarm_level = ALARM_LEVEL_LOW;
+    } else {
+      fop->alarm_level = ALARM_LEVEL_NONE;
+    }
+  }
+
+  return Bench_Hot.count;
+}
+
+static void Bench_Batch(const char *arg)
+{
+  static const int counts[] = { BENCH_TARGETS, 64, BENCH_BATCH_MAX };
+
+  Bench_Traffic(0);
+  settings->alarm = TRAFFIC_ALARM_DISTANCE;
+  Traffic_setup();
+
+  /* targets on a spiral out to about 20 km, some of them close */
+  for (int i = 0; i < BENCH_BATCH_MAX; i++) {
+    float r = 20000.0 * i / BENCH_BATCH_MAX;
+    float a = i * 2.4;
+
+    Bench_UFO[i].latitude  = ThisAircraft.latitude + r * cosf(a) / 111320.0;
+    Bench_UFO[i].longitude = ThisAircraft.longitude +
+                             r * sinf(a) / (111320.0 * cosf(radians(56.0)));
+    Bench_UFO[i].altitude  = ThisAircraft.altitude + (i % 7) * 100;
+
+    Bench_Dlat[i] = Bench_UFO[i].latitude  - ThisAircraft.latitude;
+    Bench_Dlon[i] = Bench_UFO[i].longitude - ThisAircraft.longitude;
+    Bench_Dalt[i] = Bench_UFO[i].altitude  - ThisAircraft.altitude;
+  }
+
+  printf("batch: ns per target\n");
+  printf("  %-12s %10s %10s\n", "targets", "ufo_t", "arrays");
+  for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+    Bench_Hot.count = counts[k];
+
+    double aos = Bench_Time(Bench_Batch_AoS) / counts[k];
+    double soa = Bench_Time(Bench_Batch_SoA) / counts[k];
+
+    printf("  %-12d %10.1f %10.1f\n", counts[k], aos, soa);
+  }
+}
+
+/*
+ * Traffic_Query_Radius() of the export range over a full table of targets
+ * spread BENCH_QUERY_SPREAD around own-ship: through the grid of
+ * TrafficHelper against a scan of every slot
+ */
+#define BENCH_QUERY_SPREAD  150000.0  /* metres either way */
+
+static int Bench_Slots[MAX_TRACKING_OBJECTS];
+
+static size_t Bench_Query_Grid()
+{
+  return Traffic_Query_Radius(ALARM_ZONE_NONE, 0, Bench_Slots, MAX_TRACKING_OBJECTS);
+}
+
+static size_t Bench_Query_Scan()
+{
+  int n = 0;
+
+  for (int i = 0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr && Container[i].distance < ALARM_ZONE_NONE) {
+      Bench_Slots[n++] = i;
+    }
+  }
+
+  return n;
+}
+
+static void Bench_Query(const char *arg)
+{
+  Bench_Traffic(0);
+  settings->alarm = TRAFFIC_ALARM_DISTANCE;
+  Traffic_setup();
+
+  srandom(1);
+  for (int i = 0; i < MAX_TRACKING_OBJECTS; i++) {
+    float north = BENCH_QUERY_SPREAD * (2.0 * random() / RAND_MAX - 1);
+    float east  = BENCH_QUERY_SPREAD * (2.0 * random() / RAND_MAX - 1);
+
+    Container[i].addr      = 0xEE0000 + i;
+    Container[i].protocol  = RF_PROTOCOL_OGNTP;
+    Container[i].latitude  = ThisAircraft.latitude + north / 111320.0;
+    Container[i].longitude = ThisAircraft.longitude +
+                             east / (111320.0 * cosf(radians(56.0)));
+    Container[i].altitude  = 1000;
+    Container[i].timestamp = ThisAircraft.timestamp;
+  }
+
+  /* distances and cells of all of them */
+  Traffic_UpdateAll();
+
+  size_t scan_n = Bench_Query_Scan();
+  size_t grid_n = Bench_Query_Grid();
+
+  if (grid_n != scan_n) {
+    fprintf( stderr, "query: grid found %u of %u targets\n",
+             (unsigned int) grid_n, (unsigned int) scan_n );
+    return;
+  }
+
+  double grid = Bench_Time(Bench_Query_Grid);
+  double scan = Bench_Time(Bench_Query_Scan);
+
+  printf("query: %d targets, %u within %d m, ns per query\n",
+         MAX_TRACKING_OBJECTS, (unsigned int) grid_n, ALARM_ZONE_NONE);
+  printf("  %-12s %10.0f\n", "scan", scan);
+  printf("  %-12s %10.0f\n", "grid", grid);
+}
+
+/*
+ * Unit conversions of one packet each way, the fixed-point helpers of
+ * SoftRF.h against the double precision expressions they replaced
+ */
+static volatile float   Bench_Deg  = 56.0123456;
+static volatile float   Bench_Alt  = 1234.5;
+static volatile float   Bench_Kt   = 48.6;
+static volatile float   Bench_Fpm  = -345.0;
+static volatile int32_t Bench_Deg7 = 560123456;
+static volatile int32_t Bench_Cms  = 2500;
+
+static size_t Bench_Units_Fixed()
+{
+  float   lat  = deg7_to_deg(Bench_Deg7);
+  float   kt   = cms_to_knots(Bench_Cms);
+  float   fpm  = cms_to_fpm(Bench_Cms);
+  int32_t deg7 = deg_to_deg7(Bench_Deg);
+  int32_t ft   = m_to_ft(Bench_Alt);
+  int32_t cms  = knots_to_cms(Bench_Kt) + fpm_to_cms(Bench_Fpm);
+
+  return (size_t) (lat + kt + fpm) + deg7 + ft + cms;
+}
+
+static size_t Bench_Units_Double()
+{
+  float   lat  = Bench_Deg7 / 1e7;
+  float   kt   = Bench_Cms / (100 * _GPS_MPS_PER_KNOT);
+  float   fpm  = Bench_Cms * (_GPS_FEET_PER_METER * 60.0) / 100;
+  int32_t deg7 = (int32_t) (Bench_Deg * 1e7);
+  int32_t ft   = (int32_t) (Bench_Alt * _GPS_FEET_PER_METER);
+  int32_t cms  = (int32_t) (Bench_Kt * _GPS_MPS_PER_KNOT * 100) +
+                 (int32_t) (Bench_Fpm * 100 / (_GPS_FEET_PER_METER * 60.0));
+
+  return (size_t) (lat + kt + fpm) + deg7 + ft + cms;
+}
+
+static void Bench_Units(const char *arg)
+{
+  double fixed  = Bench_Time(Bench_Units_Fixed);
+  double dbl    = Bench_Time(Bench_Units_Double);
+
+#if defined(__SOFTFP__)
+  printf("units: ns per packet, soft-float\n");
+#else
+  printf("units: ns per packet, hard-float\n");
+#endif
+  printf("  %-12s %10.1f\n", "double", dbl);
+  printf("  %-12s %10.1f\n", "fixed-point", fixed);
+}
+
+/*
+ * Climb rate of VarioHelper against the averaging of four finite
+ * differences it replaced. A trace is a time ordered list of baro
+ * samples and GNSS climb rates; "vario" simulates one, "vario:<file>"
+ * replays a recorded one with lines of
+ *   <ms> <baro altitude m|-> <GNSS climb m/s|-> [<true climb m/s>]
+ * Without the true climb, the reference is the least squares slope of the
+ * baro altitude over a window centred on each sample, which has no lag.
+ * Lag is the shift of the reference that fits an estimate best,
+ * noise is the RMS error that is left at that shift.
+ */
+#define BENCH_VARIO_MAX       8192
+#define BENCH_VARIO_NONE      INT32_MIN
+#define BENCH_VARIO_WINDOW_MS 2000  /* half of the reference window */
+#define BENCH_VARIO_LAG_MS    3000  /* longest lag looked for */
+#define BENCH_VARIO_AVERAGE   4     /* VS_AVERAGING_FACTOR of old */
+
+typedef struct {
+  unsigned long ms;
+  int32_t       baro;   /* cm */
+  int32_t       gnss;   /* cm/s */
+  int32_t       truth;  /* cm/s */
+} bench_vario_t;
+
+static bench_vario_t Bench_Vario_Trace[BENCH_VARIO_MAX];
+static int           Bench_Vario_Count;
+
+static float Bench_Gauss(float sigma)
+{
+  float u = (random() + 1.0f) / (RAND_MAX + 2.0f);
+  float v = (random() + 1.0f) / (RAND_MAX + 2.0f);
+
+  return sigma * sqrtf(-2 * logf(u)) * cosf(2 * PI * v);
+}
+
+/*
+ * Two minutes of 4 Hz baro with 0.3 m of noise and 5 Hz GNSS climb
+ * with 0.15 m/s of noise: level, then 2 m/s up, then 1 m/s down
+ */
+static void Bench_Vario_Simulate()
+{
+  float altitude = 1000;
+  int n = 0;
+
+  srandom(1);
+
+  for (unsigned long ms = 0; ms < 120000 && n < BENCH_VARIO_MAX; ms += 50) {
+    float climb = ms < 40000 ? 0 : ms < 80000 ? 2.0 : -1.0;
+    bool baro = ms % 250 == 0;
+    bool gnss = ms % 200 == 0;
+
+    altitude += climb * 0.05;
+
+    if (baro || gnss) {
+      Bench_Vario_Trace[n].ms    = ms;
+      Bench_Vario_Trace[n].baro  = baro ? (int32_t) ((altitude + Bench_Gauss(0.3)) * 100) :
+                                    BENCH_VARIO_NONE;
+      Bench_Vario_Trace[n].gnss  = gnss ? (int32_t) ((climb + Bench_Gauss(0.15)) * 100) :
+                                    BENCH_VARIO_NONE;
+      Bench_Vario_Trace[n].truth = (int32_t) (climb * 100);
+      n++;
+    }
+  }
+  Bench_Vario_Count = n;
+}
+
+static bool Bench_Vario_Load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  char line[128];
+  int n = 0;
+
+  if (f == NULL) {
+    fprintf( stderr, "vario: unable to open %s\n", path );
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), f) && n < BENCH_VARIO_MAX) {
+    char baro[32], gnss[32], truth[32] = "-";
+    unsigned long ms;
+
+    if (line[0] == '#' || sscanf(line, "%lu %31s %31s %31s", &ms, baro, gnss, truth) < 3) {
+      continue;
+    }
+    Bench_Vario_Trace[n].ms    = ms;
+    Bench_Vario_Trace[n].baro  = strcmp(baro,  "-") ? (int32_t) (atof(baro)  * 100) : BENCH_VARIO_NONE;
+    Bench_Vario_Trace[n].gnss  = strcmp(gnss,  "-") ? (int32_t) (atof(gnss)  * 100) : BENCH_VARIO_NONE;
+    Bench_Vario_Trace[n].truth = strcmp(truth, "-") ? (int32_t) (atof(truth) * 100) : BENCH_VARIO_NONE;
+    n++;
+  }
+  fclose(f);
+  Bench_Vario_Count = n;
+
+  return n > 0;
+}
+
+/* climb rate estimates at the baro samples, cm/s */
+static int32_t Bench_Vario_Old[BENCH_VARIO_MAX];
+static int32_t Bench_Vario_New[BENCH_VARIO_MAX];
+static int32_t Bench_Vario_Ref[BENCH_VARIO_MAX];
+static bool    Bench_Vario_GNSS;
+
+static size_t Bench_Vario_Run()
+{
+  float vs[BENCH_VARIO_AVERAGE] = { 0 };
+  int ndx = 0, last = -1;
+
+  Vario.valid = false;
+
+  for (int i = 0; i < Bench_Vario_Count; i++) {
+    bench_vario_t *s = &Bench_Vario_Trace[i];
+
+    Bench_Vario_Old[i] = Bench_Vario_New[i] = BENCH_VARIO_NONE;
+
+    if (s->gnss != BENCH_VARIO_NONE && Bench_Vario_GNSS) {
+      Vario_GNSS(s->gnss);
+    }
+    if (s->baro == BENCH_VARIO_NONE) {
+      continue;
+    }
+
+    Vario_Baro(s->ms, s->baro);
+    Bench_Vario_New[i] = Vario.climb;
+
+    if (last >= 0 && s->ms > Bench_Vario_Trace[last].ms) {
+      float sum = 0;
+
+      vs[ndx] = (s->baro - Bench_Vario_Trace[last].baro) * 1000.0 /
+                (s->ms - Bench_Vario_Trace[last].ms);
+      ndx = (ndx + 1) % BENCH_VARIO_AVERAGE;
+      for (int k = 0; k < BENCH_VARIO_AVERAGE; k++) {
+        sum += vs[k];
+      }
+      Bench_Vario_Old[i] = (int32_t) (sum / BENCH_VARIO_AVERAGE);
+    }
+    last = i;
+  }
+
+  return Bench_Vario_Count;
+}
+
+static void Bench_Vario_Reference()
+{
+  for (int i = 0, lo = 0; i < Bench_Vario_Count; i++) {
+    bench_vario_t *s = &Bench_Vario_Trace[i];
+    double st = 0, sa = 0, stt = 0, sta = 0;
+    int n = 0;
+
+    Bench_Vario_Ref[i] = s->truth;
+    if (s->truth != BENCH_VARIO_NONE || s->baro == BENCH_VARIO_NONE ||
+        s->ms < BENCH_VARIO_WINDOW_MS) {
+      continue;
+    }
+
+    while (s->ms - Bench_Vario_Trace[lo].ms > BENCH_VARIO_WINDOW_MS) {
+      lo++;
+    }
+
+    /* least squares slope of the baro samples within the window */
+    for (int k = lo; k < Bench_Vario_Count &&
+         Bench_Vario_Trace[k].ms <= s->ms + BENCH_VARIO_WINDOW_MS; k++) {
+      if (Bench_Vario_Trace[k].baro != BENCH_VARIO_NONE) {
+        double t = ((long) Bench_Vario_Trace[k].ms - (long) s->ms) / 1000.0;
+        double a = Bench_Vario_Trace[k].baro;
+
+        st += t; sa += a; stt += t * t; sta += t * a;
+        n++;
+      }
+    }
+
+    /* a full window only, centred on the sample */
+    if (Bench_Vario_Trace[Bench_Vario_Count - 1].ms >= s->ms + BENCH_VARIO_WINDOW_MS &&
+        n > 2 && n * stt > st * st) {
+      Bench_Vario_Ref[i] = (int32_t) ((n * sta - st * sa) / (n * stt - st * st));
+    }
+  }
+}
+
+/* best lag in ms, noise in cm/s */
+static void Bench_Vario_Fit(const int32_t *est, unsigned long *lag, float *noise)
+{
+  *lag   = 0;
+  *noise = -1;
+
+  for (unsigned long shift = 0; shift <= BENCH_VARIO_LAG_MS; shift += 50) {
+    double sum = 0;
+    int count = 0;
+
+    /* reference at ms - shift against the estimate at ms */
+    for (int i = 0, j = 0; i < Bench_Vario_Count; i++) {
+      unsigned long ms = Bench_Vario_Trace[i].ms;
+
+      if (est[i] == BENCH_VARIO_NONE || ms < shift + BENCH_VARIO_LAG_MS) {
+        continue;
+      }
+      while (j < i && Bench_Vario_Trace[j].ms < ms - shift) {
+        j++;
+      }
+      if (Bench_Vario_Trace[j].ms != ms - shift || Bench_Vario_Ref[j] == BENCH_VARIO_NONE) {
+        continue;
+      }
+      sum += (double) (est[i] - Bench_Vario_Ref[j]) * (est[i] - Bench_Vario_Ref[j]);
+      count++;
+    }
+
+    if (count > 0 && (*noise < 0 || sqrt(sum / count) < *noise)) {
+      *noise = sqrt(sum / count);
+      *lag   = shift;
+    }
+  }
+}
+
+static void Bench_Vario_Print(const char *name, const int32_t *est, double ns)
+{
+  unsigned long lag;
+  float noise;
+
+  Bench_Vario_Fit(est, &lag, &noise);
+  printf("  %-18s %8lu %10.1f %10.0f\n", name, lag, noise, ns);
+}
+
+static void Bench_Vario(const char *path)
+{
+  if (path == NULL) {
+    Bench_Vario_Simulate();
+  } else if (!Bench_Vario_Load(path)) {
+    return;
+  }
+  Bench_Vario_Reference();
+
+  printf("vario: %d samples of %s, lag ms, noise cm/s, ns per sample\n",
+         Bench_Vario_Count, path ? path : "simulation");
+  printf("  %-18s %8s %10s %10s\n", "", "lag", "noise", "cost");
+
+  /* the cost is that of both, the old averaging and the filter */
+  Bench_Vario_GNSS = false;
+  double ns = Bench_Time(Bench_Vario_Run) / Bench_Vario_Count;
+  Bench_Vario_Print("average of 4", Bench_Vario_Old, ns);
+  Bench_Vario_Print("filter, baro", Bench_Vario_New, ns);
+
+  Bench_Vario_GNSS = true;
+  ns = Bench_Time(Bench_Vario_Run) / Bench_Vario_Count;
+  Bench_Vario_Print("filter, baro+GNSS", Bench_Vario_New, ns);
+}
+
+static const struct {
+  const char *name;
+  void      (*run)(const char *);
+  const char *desc;
+} Bench_Table[] = {
+  { "cbor",  Bench_CBOR,      "CBOR against PingStation JSON export" },
+  { "enu",   Bench_ENU_Frame, "east-north frame against the great circle" },
+  { "track", Bench_Track,     "target tracker, per packet and prediction" },
+  { "query", Bench_Query,     "export range query of a full table, grid or scan" },
+  { "units", Bench_Units,     "fixed-point unit conversions of a packet" },
+  { "batch", Bench_Batch,     "geometry of 8, 64 and 1024 targets, ufo_t or arrays" },
+  { "vario", Bench_Vario,     "climb rate filter, simulated or vario:<trace>" },
+};
+
+#define BENCH_COUNT (sizeof(Bench_Table) / sizeof(Bench_Table[0]))
+
+/* "all", "<name>" or "<name>:<argument>" */
+bool Bench_Run(const char *name)
+{
+  const char *arg = strchr(name, ':');
+  size_t len = arg ? arg - name : strlen(name);
+  bool found = false;
+
+  for (size_t i = 0; i < BENCH_COUNT; i++) {
+    if (!strcmp(name, "all") ||
+        (strlen(Bench_Table[i].name) == len &&
+         !strncmp(name, Bench_Table[i].name, len))) {
+      Bench_Table[i].run(arg ? arg + 1 : NULL);
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+void Bench_Usage(FILE *f)
+{
+  for (size_t i = 0; i < BENCH_COUNT; i++) {
+    fprintf(f, "             %-8s %s\n", Bench_Table[i].name, Bench_Table[i].desc);
+  }
+}
+
+#endif /* RASPBERRY_PI */
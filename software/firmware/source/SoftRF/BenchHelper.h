@@ -0,0 +1,38 @@
+/*
+ * BenchHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHHELPER_H
+#define BENCHHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Host benchmarks of the hot paths, run with -b <name>.
+ * Each figure is the best of BENCH_ROUNDS rounds that last
+ * at least BENCH_ROUND_NS each.
+ */
+#define BENCH_ROUNDS      5
+#define BENCH_ROUND_NS    100000000ULL
+
+/* gliders around own-ship in the cbor, enu and track benches */
+#define BENCH_TARGETS     8
+
+bool Bench_Run(const char *);
+void Bench_Usage(FILE *);
+
+#endif /* BENCHHELPER_H */
@@ -25,6 +25,7 @@
 #include "EEPROMHelper.h"
 #include "SoCHelper.h"
 #include "TrafficHelper.h"
+#include "OutputHelper.h"
 #include "SoftRF.h"
 
 #define ADDR_TO_HEX_STR(s, c) (s += ((c) < 0x10 ? "0" : "") + String((c), HEX))
@@ -37,20 +38,22 @@
         }                                               \
       })
 
+#define isTimeToD1090Export() (millis() - D1090_ExportTimeMarker >= \
+                               EXPORT_INTERVAL_MS(settings->d1090_rate))
+static unsigned long D1090_ExportTimeMarker = 0;
+
 static void D1090_Out(byte *buf, size_t size)
 {
   switch(settings->d1090)
   {
   case D1090_UART:
     {
-      Serial.write(buf, size);
+      Output_Write(OUTPUT_SERIAL, buf, size);
     }
     break;
   case D1090_BLUETOOTH:
     {
-      if (SoC->Bluetooth) {
-        SoC->Bluetooth->write(buf, size);
-      }
+      Output_Write(OUTPUT_BLUETOOTH, buf, size);
     }
     break;
   case D1090_UDP:
@@ -68,13 +71,19 @@ void D1090_Export()
   String str;
   time_t this_moment = now();
 
-  if (settings->d1090 != D1090_OFF) {
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+  if (settings->d1090 != D1090_OFF && isTimeToD1090Export()) {
+    int slots[MAX_TRACKING_OBJECTS];
+    int count = Traffic_Query_Radius(ALARM_ZONE_NONE, 0, slots, MAX_TRACKING_OBJECTS);
+
+    for (int k=0; k < count; k++) {
+      int i = slots[k];
+
       if (Container[i].addr && (this_moment - Container[i].timestamp) <= EXPORT_EXPIRATION_TIME) {
 
         distance = Container[i].distance;
 
-        if (distance < ALARM_ZONE_NONE) {
+        if (distance < ALARM_ZONE_NONE &&
+            Traffic_NeedsExport(i, EXPORT_SINK_D1090)) {
 
           double altitude;
           /* If the aircraft's data has standard pressure altitude - make use it */
@@ -136,5 +145,7 @@ void D1090_Export()
         }
       }
     }
+
+    D1090_ExportTimeMarker = millis();
   }
 }
@@ -90,6 +90,14 @@ void EEPROM_defaults()
   eeprom_block.field.settings.stealth    = false;
   eeprom_block.field.settings.no_track   = false;
   eeprom_block.field.settings.power_save = POWER_SAVE_NONE;
+
+  eeprom_block.field.settings.nmea_rate    = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.gdl90_rate   = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.d1090_rate   = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.json_rate    = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.export_delta = false;
+  eeprom_block.field.settings.json_out     = JSON_OUT_STDOUT;
+  eeprom_block.field.settings.gnss_pvt     = false;
 }
 
 void EEPROM_store()
@@ -26,7 +26,7 @@
 #include "SoftRF.h"
 
 #define SOFTRF_EEPROM_MAGIC 0xBABADEDA
-#define SOFTRF_EEPROM_VERSION 0x0000005D
+#define SOFTRF_EEPROM_VERSION 0x0000005F
 
 typedef struct Settings {
     uint8_t  mode;
@@ -55,11 +55,16 @@ typedef struct Settings {
     uint8_t  json:2;
 
     uint8_t  power_save;
-    uint8_t  resvd2345;
-    uint8_t  resvd6;
-    uint8_t  resvd7;
-    uint8_t  resvd8;
-    uint8_t  resvd9;
+
+    uint8_t  nmea_rate;     /* per-sink traffic export rates */
+    uint8_t  gdl90_rate;
+    uint8_t  d1090_rate;
+    uint8_t  json_rate;
+
+    bool     export_delta:1; /* export changed traffic only */
+    uint8_t  json_out:2;
+    bool     gnss_pvt:1;     /* u-blox NAV-PVT instead of NMEA */
+    uint8_t  resvd9:4;
     uint8_t  resvd10;
     uint8_t  resvd11;
     uint8_t  resvd12;
@@ -86,4 +91,4 @@ void EEPROM_defaults(void);
 void EEPROM_store(void);
 extern settings_t *settings;
 
-#endif /* EEPROMHELPER_H */
\ No newline at end of file
+#endif /* EEPROMHELPER_H */
\ No newline at end of file
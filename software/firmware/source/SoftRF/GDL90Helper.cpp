@@ -32,6 +32,8 @@
 #include "TrafficHelper.h"
 #include "Protocol_Legacy.h"
 #include "NMEAHelper.h"
+#include "OutputHelper.h"
+#include "LatencyHelper.h"
 
 #if defined(ENABLE_AHRS)
 #include "AHRSHelper.h"
@@ -39,9 +41,11 @@
 
 #define ADDR_TO_HEX_STR(s, c) (s += ((c) < 0x10 ? "0" : "") + String((c), HEX))
 
-static GDL90_Msg_HeartBeat_t HeartBeat;
-static GDL90_Msg_Traffic_t Traffic;
-static GDL90_Msg_OwnershipGeometricAltitude_t GeometricAltitude;
+#define isTimeToGDL90Export() (millis() - GDL90_ExportTimeMarker >= \
+                               EXPORT_INTERVAL_MS(settings->gdl90_rate))
+#define isTimeToHeartbeat()   (millis() - GDL90_HeartbeatTimeMarker >= 1000)
+static unsigned long GDL90_ExportTimeMarker    = 0;
+static unsigned long GDL90_HeartbeatTimeMarker = 0;
 
 const char *GDL90_CallSign_Prefix[] = {
   [RF_PROTOCOL_LEGACY]    = "FL",
@@ -150,73 +154,88 @@ static uint32_t makeLongitude(float longitude)
     return(int_lon);    
 }
 
+/*
+ * Single pass frame writer: every payload byte is added to the FCS,
+ * escaped and stored into the output buffer as it is produced.
+ */
+typedef struct GDL90_Writer {
+  uint8_t  *ptr;
+  uint16_t fcs;
+} GDL90_Writer_t;
 
-static uint32_t pack24bit(uint32_t num)
+static inline void GDL90_Put(GDL90_Writer_t *w, uint8_t c)
 {
-  return( ((num & 0xff0000) >> 16) | (num & 0x00ff00) | ((num & 0xff) << 16) );
+  w->fcs = update_crc_gdl90(w->fcs, c);
+
+  if (c == 0x7D || c == 0x7E) {
+    *w->ptr++ = 0x7D;
+    *w->ptr++ = c ^ 0x20;
+  } else {
+    *w->ptr++ = c;
+  }
 }
 
-uint16_t GDL90_calcFCS(uint8_t msg_id, uint8_t *msg, int size)
+/* big endian ("MSB first") field of 'bytes' width */
+static inline void GDL90_PutBE(GDL90_Writer_t *w, uint32_t val, int bytes)
 {
-  uint16_t crc16 = 0x0000;  /* seed value */
+  while (bytes--) {
+    GDL90_Put(w, (val >> (bytes * 8)) & 0xFF);
+  }
+}
 
-  crc16 = update_crc_gdl90(crc16, msg_id);
+static inline void GDL90_PutData(GDL90_Writer_t *w, const uint8_t *p, int size)
+{
+  while (size--) {
+    GDL90_Put(w, *p++);
+  }
+}
 
-  for (int i=0; i < size; i++)
-  {
-    crc16 = update_crc_gdl90(crc16, msg[i]);
-  }    
+static inline void GDL90_Begin(GDL90_Writer_t *w, uint8_t *buf, uint8_t id)
+{
+  w->ptr = buf;
+  w->fcs = 0x0000; /* seed value */
 
-  return(crc16);
+  *w->ptr++ = 0x7E; /* Start flag */
+  GDL90_Put(w, id);
 }
 
-uint8_t *GDL90_EscapeFilter(uint8_t *buf, uint8_t *p, int size)
+static inline size_t GDL90_End(GDL90_Writer_t *w, uint8_t *buf)
 {
-  while (size--) {
-    if (*p != 0x7D && *p != 0x7E) {
-      *buf++ = *p++;
-    } else {
-      *buf++ = 0x7D;
-      *buf++ = *p++ ^ 0x20;
-    }   
-  }
+  uint16_t fcs = w->fcs;
+
+  /* FCS is LSB first and is not a part of its own calculation */
+  GDL90_Put(w, fcs        & 0xFF);
+  GDL90_Put(w, (fcs >> 8) & 0xFF);
+  *w->ptr++ = 0x7E; /* Stop flag */
 
-  return (buf);
+  return (w->ptr - buf);
 }
 
-static void *msgHeartbeat()
+static size_t makeHeartbeat(uint8_t *buf)
 {
+  GDL90_Writer_t w;
   time_t ts = elapsedSecsToday(now());
 
-  /* Status Byte 1 */
-  HeartBeat.gnss_pos_valid  = 1 /* isValidFix() */ ;
-  HeartBeat.maint_reqd      = 0;
-  HeartBeat.ident           = 0;
-  HeartBeat.addr_type       = 0;
-  HeartBeat.gnss_bat_low    = 0;
-  HeartBeat.ratcs           = 0;
-//HeartBeat.reserved1       = 0;
-  HeartBeat.uat_init        = 1;
-
-  /* Status Byte 2 */
-  HeartBeat.time_stamp_ms   = (ts >> 16) & 1;
-  HeartBeat.csa_req         = 0;
-  HeartBeat.csa_not_avail   = 0;
-//HeartBeat.reserved2       = 0;
-//HeartBeat.reserved3       = 0;
-//HeartBeat.reserved4       = 0;
-//HeartBeat.reserved5       = 0;
-  HeartBeat.utc_ok          = 0;
-
-  HeartBeat.time_stamp      = (ts & 0xFFFF);   // LSB first
-  HeartBeat.message_counts  = 0;
-
-  return (&HeartBeat);
+  GDL90_Begin(&w, buf, GDL90_HEARTBEAT_MSG_ID);
+
+  /* Status Byte 1: GNSS position valid, UAT initialized */
+  GDL90_Put(&w, GDL90_HB_GNSS_POS_VALID | GDL90_HB_UAT_INIT);
+  /* Status Byte 2: time stamp bit 16 */
+  GDL90_Put(&w, ((ts >> 16) & 1) ? GDL90_HB_TIME_STAMP_MS : 0);
+  /* Time stamp, LSB first */
+  GDL90_Put(&w,  ts       & 0xFF);
+  GDL90_Put(&w, (ts >> 8) & 0xFF);
+  /* Message counts */
+  GDL90_PutBE(&w, 0, 2);
+
+  return GDL90_End(&w, buf);
 }
 
-static void *msgType10and20(ufo_t *aircraft)
+static size_t makeType10and20(uint8_t *buf, uint8_t id, ufo_t *aircraft)
 {
+  GDL90_Writer_t w;
   int altitude;
+  uint8_t callsign[GDL90_CALLSIGN_SIZE];
 
   /*
    * The Altitude field "ddd" contains the pressure altitude
@@ -229,68 +248,42 @@ static void *msgType10and20(ufo_t *aircraft)
 
   /* If the aircraft's data has standard pressure altitude - make use it */
   if (aircraft->pressure_altitude != 0.0) {
-    altitude = (int)(aircraft->pressure_altitude * _GPS_FEET_PER_METER);
+    altitude = m_to_ft(aircraft->pressure_altitude);
   } else if (ThisAircraft.pressure_altitude != 0.0) {
     /* If this SoftRF unit is equiped with baro sensor - try to make an adjustment */
     float altDiff = ThisAircraft.pressure_altitude - ThisAircraft.altitude;
-    altitude = (int)((aircraft->altitude + altDiff) * _GPS_FEET_PER_METER);
+    altitude = m_to_ft(aircraft->altitude + altDiff);
   } else {
     /* If there are no any choice - report GNSS AMSL altitude as pressure altitude */
-    altitude = (int)(aircraft->altitude * _GPS_FEET_PER_METER);
+    altitude = m_to_ft(aircraft->altitude);
   }
   altitude = (altitude + 1000) / 25; /* Resolution = 25 feet */
 
   int trackHeading = (int)(aircraft->course / (360.0 / 256)); /* convert to 1.4 deg single byte */
 
   if (altitude < 0) {
-    altitude = 0;  
+    altitude = 0;
   }
   if (altitude > 0xffe) {
-    altitude = 0xffe;  
+    altitude = 0xffe;
   }
- 
-  uint8_t misc = 9;
-  //altitude = 0x678;
-  
-  uint16_t horiz_vel = (uint16_t) aircraft->speed /* 0x123 */ ; /*  in knots */
-  uint16_t vert_vel = (uint16_t) ((int16_t) (aircraft->vs / 64.0)) /* 0x456 */; /* in units of 64 fpm */
-
-  Traffic.alert_status  = 0 /* 0x1 */;
-  Traffic.addr_type     = 0 /* 0x2 */;
-  Traffic.addr          = pack24bit(aircraft->addr) /* pack24bit(0x345678) */;
-  Traffic.latitude      = pack24bit(makeLatitude(aircraft->latitude)) /* pack24bit(0x9abcde) */;
-  Traffic.longitude     = pack24bit(makeLongitude(aircraft->longitude)) /* pack24bit(0xf12345) */;
-
-  /*
-   * workaround against "implementation dependant"
-   * XTENSA's GCC bitmap layout in structures
-   */
-  Traffic.altitude      = ((altitude >> 4) & 0xFF) | (misc << 8);
-  Traffic.misc          = (altitude & 0x00F);
-
-  Traffic.nic           = 8 /* 0xa */;
-  Traffic.nacp          = 8 /* 0xb */;
 
-  /*
-   * workaround against "implementation dependant"
-   * XTENSA's GCC bitmap layout in structures
-   */
-
-  Traffic.horiz_vel = (((vert_vel >> 8) & 0xF) << 8)| (((horiz_vel >> 8) & 0xF) << 4) | ((horiz_vel >> 4) & 0xF) ;
-  Traffic.vert_vel =  (((vert_vel >> 4) & 0xF) << 8) | ((vert_vel & 0xF) << 4) | (horiz_vel & 0xF) ;
+  uint8_t misc = 9;
 
-  Traffic.track         = (trackHeading & 0xFF) /* 0x03 */;
-  Traffic.emit_cat      = AT_TO_GDL90(aircraft->aircraft_type) /* 0x4 */;
+  uint16_t horiz_vel = (uint16_t) aircraft->speed; /*  in knots */
+  uint16_t vert_vel = (uint16_t) ((int16_t) (aircraft->vs / 64.0)); /* in units of 64 fpm */
 
   /*
    * When callsign is available - send it to a GDL90 client.
    * If it is not - generate a callsign substitute,
    * based upon a protocol ID and the ICAO address
    */
+  memset(callsign, 0, sizeof(callsign));
+
   if (strnlen((char *) aircraft->callsign, sizeof(aircraft->callsign)) > 0) {
-    memcpy(Traffic.callsign, aircraft->callsign, sizeof(Traffic.callsign));
+    memcpy(callsign, aircraft->callsign, sizeof(callsign));
   } else {
-    memcpy((char *)Traffic.callsign, GDL90_CallSign_Prefix[aircraft->protocol],
+    memcpy((char *)callsign, GDL90_CallSign_Prefix[aircraft->protocol],
       strlen(GDL90_CallSign_Prefix[aircraft->protocol]));
 
     String str = "";
@@ -300,18 +293,43 @@ static void *msgType10and20(ufo_t *aircraft)
     ADDR_TO_HEX_STR(str, (aircraft->addr      ) & 0xFF);
 
     str.toUpperCase();
-    memcpy((char *)Traffic.callsign + strlen(GDL90_CallSign_Prefix[aircraft->protocol]),
+    memcpy((char *)callsign + strlen(GDL90_CallSign_Prefix[aircraft->protocol]),
       str.c_str(), str.length());
   }
 
-  Traffic.emerg_code    = 0 /* 0x5 */;
-//Traffic.reserved      = 0;
+  GDL90_Begin(&w, buf, id);
+
+  /* alert status 's' (0 - no alert) and address type 't' (0 - ICAO) */
+  GDL90_Put  (&w, 0x00);
+  GDL90_PutBE(&w, aircraft->addr & 0xFFFFFF, 3);
+  GDL90_PutBE(&w, makeLatitude(aircraft->latitude), 3);
+  GDL90_PutBE(&w, makeLongitude(aircraft->longitude), 3);
+
+  /* "ddd m" */
+  GDL90_Put  (&w, (altitude >> 4) & 0xFF);
+  GDL90_Put  (&w, ((altitude & 0x0F) << 4) | misc);
+
+  /* NIC, NACp */
+  GDL90_Put  (&w, (8 << 4) | 8);
 
-  return (&Traffic);
+  /* "hhh vvv" */
+  GDL90_Put  (&w, (horiz_vel >> 4) & 0xFF);
+  GDL90_Put  (&w, ((horiz_vel & 0x0F) << 4) | ((vert_vel >> 8) & 0x0F));
+  GDL90_Put  (&w, vert_vel & 0xFF);
+
+  GDL90_Put  (&w, trackHeading & 0xFF);
+  GDL90_Put  (&w, AT_TO_GDL90(aircraft->aircraft_type));
+  GDL90_PutData(&w, callsign, sizeof(callsign));
+
+  /* emergency/priority code 'p' (0 - no emergency) and spare */
+  GDL90_Put  (&w, 0x00);
+
+  return GDL90_End(&w, buf);
 }
 
-static void *msgOwnershipGeometricAltitude(ufo_t *aircraft)
+static size_t makeGeometricAltitude(uint8_t *buf, ufo_t *aircraft)
 {
+  GDL90_Writer_t w;
   uint16_t vfom = 0x000A;
 
 #if 0
@@ -328,104 +346,45 @@ static void *msgOwnershipGeometricAltitude(ufo_t *aircraft)
    * and uses MSL altitude here.
    * SkyDemon is the only known exception which uses WGS-84 altitude still.
    */
-  uint16_t altitude = (int16_t)(aircraft->altitude * _GPS_FEET_PER_METER / 5);
+  uint16_t altitude = (int16_t)(m_to_ft(aircraft->altitude) / 5);
 #endif
 
-  GeometricAltitude.geo_altitude  = ((altitude & 0x00FF) << 8) | ((altitude & 0xFF00) >> 8) ;
-  GeometricAltitude.VFOM          = ((vfom & 0x00FF) << 8) | ((vfom & 0xFF00) >> 8);
-  GeometricAltitude.vert_warning  = 0;
-
-  return (&GeometricAltitude);
-}
-
-static size_t makeHeartbeat(uint8_t *buf)
-{
-  uint8_t *ptr = buf;
-  uint8_t *msg = (uint8_t *) msgHeartbeat();
-  uint16_t fcs = GDL90_calcFCS(GDL90_HEARTBEAT_MSG_ID, msg,
-                               sizeof(GDL90_Msg_HeartBeat_t));
-  uint8_t fcs_lsb, fcs_msb;
-  
-  fcs_lsb = fcs        & 0xFF;
-  fcs_msb = (fcs >> 8) & 0xFF;
-
-  *ptr++ = 0x7E; /* Start flag */
-  *ptr++ = GDL90_HEARTBEAT_MSG_ID;
-  ptr = GDL90_EscapeFilter(ptr, msg, sizeof(GDL90_Msg_HeartBeat_t));
-  ptr = GDL90_EscapeFilter(ptr, &fcs_lsb, 1);
-  ptr = GDL90_EscapeFilter(ptr, &fcs_msb, 1);
-  *ptr++ = 0x7E; /* Stop flag */
-
-  return(ptr-buf);
-}
+  GDL90_Begin(&w, buf, GDL90_OWNGEOMALT_MSG_ID);
 
-static size_t makeType10and20(uint8_t *buf, uint8_t id, ufo_t *aircraft)
-{
-  uint8_t *ptr = buf;
-  uint8_t *msg = (uint8_t *) msgType10and20(aircraft);
-  uint16_t fcs = GDL90_calcFCS(id, msg, sizeof(GDL90_Msg_Traffic_t));
-  uint8_t fcs_lsb, fcs_msb;
-  
-  fcs_lsb = fcs        & 0xFF;
-  fcs_msb = (fcs >> 8) & 0xFF;
-
-  *ptr++ = 0x7E; /* Start flag */
-  *ptr++ = id;
-  ptr = GDL90_EscapeFilter(ptr, msg, sizeof(GDL90_Msg_Traffic_t));
-  ptr = GDL90_EscapeFilter(ptr, &fcs_lsb, 1);
-  ptr = GDL90_EscapeFilter(ptr, &fcs_msb, 1);
-  *ptr++ = 0x7E; /* Stop flag */
-
-  return(ptr-buf);
-}
+  GDL90_PutBE(&w, altitude, 2);
+  /* vertical warning indicator (0 - none) and VFOM */
+  GDL90_PutBE(&w, vfom & 0x7FFF, 2);
 
-static size_t makeGeometricAltitude(uint8_t *buf, ufo_t *aircraft)
-{
-  uint8_t *ptr = buf;
-  uint8_t *msg = (uint8_t *) msgOwnershipGeometricAltitude(aircraft);
-  uint16_t fcs = GDL90_calcFCS(GDL90_OWNGEOMALT_MSG_ID, msg,
-                               sizeof(GDL90_Msg_OwnershipGeometricAltitude_t));
-  uint8_t fcs_lsb, fcs_msb;
-
-  fcs_lsb = fcs        & 0xFF;
-  fcs_msb = (fcs >> 8) & 0xFF;
-
-  *ptr++ = 0x7E; /* Start flag */
-  *ptr++ = GDL90_OWNGEOMALT_MSG_ID;
-  ptr = GDL90_EscapeFilter(ptr, msg, sizeof(GDL90_Msg_OwnershipGeometricAltitude_t));
-  ptr = GDL90_EscapeFilter(ptr, &fcs_lsb, 1);
-  ptr = GDL90_EscapeFilter(ptr, &fcs_msb, 1);
-  *ptr++ = 0x7E; /* Stop flag */
-
-  return(ptr-buf);
+  return GDL90_End(&w, buf);
 }
 
 #if defined(DO_GDL90_FF_EXT)
 
 static size_t makeFFid(uint8_t *buf)
 {
-  uint8_t *ptr = buf;
-  uint8_t *msg = (uint8_t *) &msgFFid;
-  uint16_t fcs = GDL90_calcFCS(GDL90_FFEXT_MSG_ID, msg, sizeof(GDL90_Msg_FF_ID_t));
-  uint8_t fcs_lsb, fcs_msb;
-
-  fcs_lsb = fcs        & 0xFF;
-  fcs_msb = (fcs >> 8) & 0xFF;
-
-  *ptr++ = 0x7E; /* Start flag */
-  *ptr++ = GDL90_FFEXT_MSG_ID;
-  ptr = GDL90_EscapeFilter(ptr, msg, sizeof(GDL90_Msg_FF_ID_t));
-  ptr = GDL90_EscapeFilter(ptr, &fcs_lsb, 1);
-  ptr = GDL90_EscapeFilter(ptr, &fcs_msb, 1);
-  *ptr++ = 0x7E; /* Stop flag */
-
-  return(ptr-buf);
+  GDL90_Writer_t w;
+
+  GDL90_Begin(&w, buf, GDL90_FFEXT_MSG_ID);
+  GDL90_PutData(&w, (const uint8_t *) &msgFFid, sizeof(GDL90_Msg_FF_ID_t));
+
+  return GDL90_End(&w, buf);
 }
 #endif
 
 #define makeOwnershipReport(b,a)  makeType10and20(b, GDL90_OWNSHIP_MSG_ID, a)
 #define makeTrafficReport(b,a)    makeType10and20(b, GDL90_TRAFFIC_MSG_ID, a)
 
+/* framed messages for other producers than the export below */
+size_t GDL90_Heartbeat(uint8_t *buf)
+{
+  return makeHeartbeat(buf);
+}
+
+size_t GDL90_Traffic(uint8_t *buf, ufo_t *aircraft)
+{
+  return makeTrafficReport(buf, aircraft);
+}
+
 static void GDL90_Out(byte *buf, size_t size)
 {
   if (size > 0) {
@@ -433,19 +392,17 @@ static void GDL90_Out(byte *buf, size_t size)
     {
     case GDL90_UART:
       {
-        Serial.write(buf, size);
+        Output_Write(OUTPUT_SERIAL, buf, size);
       }
       break;
     case GDL90_UDP:
       {
-        SoC->WiFi_transmit_UDP(GDL90_DST_PORT, buf, size);
+        Output_Write(OUTPUT_UDP_GDL90, buf, size);
       }
       break;
     case GDL90_BLUETOOTH:
       {
-        if (SoC->Bluetooth) {
-          SoC->Bluetooth->write(buf, size);
-        }
+        Output_Write(OUTPUT_BLUETOOTH, buf, size);
       }
       break;
     case GDL90_TCP:
@@ -464,7 +421,12 @@ void GDL90_Export()
   uint8_t *buf = (uint8_t *) (sizeof(UDPpacketBuffer) < UDP_PACKET_BUFSIZE ?
                               NMEABuffer : UDPpacketBuffer);
 
-  if (settings->gdl90 != GDL90_OFF) {
+  if (settings->gdl90 == GDL90_OFF) {
+    return;
+  }
+
+  /* Heartbeat is due once per second, regardless of the export rate */
+  if (isTimeToHeartbeat()) {
     size = makeHeartbeat(buf);
     GDL90_Out(buf, size);
 
@@ -473,6 +435,11 @@ void GDL90_Export()
     GDL90_Out(buf, size);
 #endif /* DO_GDL90_FF_EXT */
 
+    GDL90_HeartbeatTimeMarker = millis();
+  }
+
+  if (isTimeToGDL90Export()) {
+
 #if defined(ENABLE_AHRS)
     size = AHRS_GDL90(buf);
     GDL90_Out(buf, size);
@@ -486,16 +453,25 @@ void GDL90_Export()
       GDL90_Out(buf, size);
     }
 
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    int slots[MAX_TRACKING_OBJECTS];
+    int count = Traffic_Query_Radius(ALARM_ZONE_NONE, 0, slots, MAX_TRACKING_OBJECTS);
+
+    for (int k=0; k < count; k++) {
+      int i = slots[k];
+
       if (Container[i].addr && (this_moment - Container[i].timestamp) <= EXPORT_EXPIRATION_TIME) {
 
         distance = Container[i].distance;
 
-        if (distance < ALARM_ZONE_NONE) {
+        if (distance < ALARM_ZONE_NONE &&
+            Traffic_NeedsExport(i, EXPORT_SINK_GDL90)) {
           size = makeTrafficReport(buf, &Container[i]);
           GDL90_Out(buf, size);
+          Latency_Export(&Container[i]);
         }
       }
     }
+
+    GDL90_ExportTimeMarker = millis();
   }
 }
@@ -88,6 +88,10 @@ typedef struct GDL90_Msg_HeartBeat {
 
 } __attribute__((packed)) GDL90_Msg_HeartBeat_t;
 
+#define GDL90_HB_GNSS_POS_VALID   0x80  /* Status Byte 1 */
+#define GDL90_HB_UAT_INIT         0x01
+#define GDL90_HB_TIME_STAMP_MS    0x80  /* Status Byte 2 */
+
 
 #define GDL90_OWNSHIP_MSG_ID  10
 #define GDL90_TRAFFIC_MSG_ID  20
@@ -120,6 +124,8 @@ typedef struct GDL90_Msg_Traffic {
 
 } __attribute__((packed)) GDL90_Msg_Traffic_t;
 
+#define GDL90_CALLSIGN_SIZE   8
+
 #define GDL90_OWNGEOMALT_MSG_ID  11
 
 typedef struct GDL90_Msg_OwnershipGeometricAltitude {
@@ -149,6 +155,26 @@ typedef struct GDL90_Msg_FF_ID {
 
 #endif
 
+/* Message payload lengths, less flags, message ID and FCS */
+#define GDL90_HEARTBEAT_LEN   6
+#define GDL90_TRAFFIC_LEN     27
+#define GDL90_OWNGEOMALT_LEN  4
+#define GDL90_FFEXT_ID_LEN    38
+
+/* worst case: every byte but the flags is escaped */
+#define GDL90_FRAME_SIZE(len) (2 + 2 * (1 + (len) + 2))
+
+static_assert(sizeof(GDL90_Msg_HeartBeat_t) == GDL90_HEARTBEAT_LEN,
+              "GDL90 heartbeat layout");
+static_assert(sizeof(GDL90_Msg_Traffic_t) == GDL90_TRAFFIC_LEN,
+              "GDL90 traffic report layout");
+static_assert(sizeof(GDL90_Msg_OwnershipGeometricAltitude_t) == GDL90_OWNGEOMALT_LEN,
+              "GDL90 ownship geometric altitude layout");
+#if defined(DO_GDL90_FF_EXT)
+static_assert(sizeof(GDL90_Msg_FF_ID_t) == GDL90_FFEXT_ID_LEN,
+              "GDL90 ForeFlight ID layout");
+#endif
+
 #define AT_TO_GDL90(x)  ((x) > 15 ? \
    GDL90_EMITTER_CATEGORY_NONE : pgm_read_byte(&aircraft_type_to_gdl90[(x)]))
 
@@ -160,7 +186,7 @@ extern const uint8_t gdl90_to_aircraft_type[] PROGMEM;
 extern const char *GDL90_CallSign_Prefix[];
 
 void GDL90_Export(void);
-uint16_t GDL90_calcFCS(uint8_t, uint8_t *, int);
-uint8_t *GDL90_EscapeFilter(uint8_t *, uint8_t *, int);
+size_t GDL90_Heartbeat(uint8_t *);
+size_t GDL90_Traffic(uint8_t *, ufo_t *);
 
 #endif /* GDL90HELPER_H */
\ No newline at end of file
@@ -26,6 +26,8 @@
 #include "NMEAHelper.h"
 #include "SoCHelper.h"
 #include "WiFiHelper.h"
+#include "BaroHelper.h"
+#include "VarioHelper.h"
 
 #include "SoftRF.h"
 
@@ -49,6 +51,7 @@ unsigned long GGA_Stop_Time_Marker = 0;
 
 boolean gnss_set_sucess = false ;
 TinyGPSPlus gnss;  // Create an Instance of the TinyGPS++ object called gnss
+gnss_decoded_t GNSS_Decoded;
 
 uint8_t GNSSbuf[240]; // 3 lines of 80 characters each
 int GNSS_cnt = 0;
@@ -60,6 +63,20 @@ const uint8_t setVTG[] PROGMEM = {0xF0, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
 #if !defined(NMEA_TCP_SERVICE)
 const uint8_t setGSA[] PROGMEM = {0xF0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
 #endif
+const uint8_t setGGA[] PROGMEM = {0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
+const uint8_t setRMC[] PROGMEM = {0xF0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
+ /* NAV-PVT on every solution, NAV-TIMEUTC on every 5th one */
+const uint8_t setPVT[] PROGMEM = {0x01, 0x07, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+const uint8_t setTIMEUTC[] PROGMEM = {0x01, 0x21, 0x00, 0x05, 0x00, 0x05, 0x00, 0x00};
+ /* CFG-RATE */
+const uint8_t setRate[] PROGMEM = {GNSS_PVT_RATE_MS & 0xFF, GNSS_PVT_RATE_MS >> 8,
+                                   0x01, 0x00, 0x01, 0x00};
+ /* back to NMEA: GGA and RMC on, NAV-PVT and NAV-TIMEUTC off, 1 Hz */
+const uint8_t enaGGA[] PROGMEM = {0xF0, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+const uint8_t enaRMC[] PROGMEM = {0xF0, 0x04, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+const uint8_t disPVT[] PROGMEM = {0x01, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+const uint8_t disTIMEUTC[] PROGMEM = {0x01, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+const uint8_t setRate1Hz[] PROGMEM = {0xE8, 0x03, 0x01, 0x00, 0x01, 0x00};
  /* CFG-PRT */
 uint8_t setBR[] = {0x01, 0x00, 0x00, 0x00, 0xD0, 0x08, 0x00, 0x00, 0x00, 0x96,
                    0x00, 0x00, 0x07, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -253,6 +270,64 @@ static void setup_UBX()
 #endif
 }
 
+static boolean setup_UBX_CFG(uint8_t id, uint8_t msglen, const uint8_t *msg)
+{
+  msglen = makeUBXCFG(0x06, id, msglen, msg);
+  sendUBX(GNSSbuf, msglen);
+  return getUBX_ACK(0x06, id);
+}
+
+/* u-blox 6 has no NAV-PVT, it stays on NMEA */
+static void setup_UBX_PVT()
+{
+  GNSS_DEBUG_PRINTLN(F("Switching on UBX NAV-PVT: "));
+
+  if (!setup_UBX_CFG(0x01, sizeof(setPVT), setPVT)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to enable UBX NAV-PVT."));
+    return;
+  }
+
+  if (!setup_UBX_CFG(0x01, sizeof(setTIMEUTC), setTIMEUTC)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to enable UBX NAV-TIMEUTC."));
+  }
+
+  if (!setup_UBX_CFG(0x08, sizeof(setRate), setRate)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to set navigation rate."));
+  }
+
+  if (!setup_UBX_CFG(0x01, sizeof(setGGA), setGGA) ||
+      !setup_UBX_CFG(0x01, sizeof(setRMC), setRMC)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to disable NMEA GGA and RMC."));
+  }
+
+  GNSS_Decoded.source = GNSS_DECODED_UBX_PVT;
+}
+
+/*
+ * The receiver keeps its configuration over a restart of SoftRF,
+ * so NAV-PVT set up by a previous run is undone when it is not wanted
+ */
+static void setup_UBX_NMEA()
+{
+  GNSS_DEBUG_PRINTLN(F("Switching on NMEA GGA and RMC: "));
+
+  if (!setup_UBX_CFG(0x01, sizeof(enaGGA), enaGGA) ||
+      !setup_UBX_CFG(0x01, sizeof(enaRMC), enaRMC)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to enable NMEA GGA and RMC."));
+  }
+
+  if (!setup_UBX_CFG(0x01, sizeof(disPVT), disPVT) ||
+      !setup_UBX_CFG(0x01, sizeof(disTIMEUTC), disTIMEUTC)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to disable UBX NAV-PVT and NAV-TIMEUTC."));
+  }
+
+  if (!setup_UBX_CFG(0x08, sizeof(setRate1Hz), setRate1Hz)) {
+    GNSS_DEBUG_PRINTLN(F("WARNING: Unable to set navigation rate."));
+  }
+
+  GNSS_Decoded.source = GNSS_DECODED_NONE;
+}
+
 static void setup_NMEA()
 {
   SoC->swSer_begin(9600);
@@ -375,6 +450,94 @@ static int ubloxProcessData(unsigned char data) {
 
 /* ------ END -----------  https://github.com/Black-Thunder/FPV-Tracker */
 
+#define UBX_U2(o) ((uint16_t) (GNSSbuf[o] | (GNSSbuf[(o)+1] << 8)))
+#define UBX_U4(o) ((uint32_t) GNSSbuf[o]              | \
+                   ((uint32_t) GNSSbuf[(o)+1] <<  8)  | \
+                   ((uint32_t) GNSSbuf[(o)+2] << 16)  | \
+                   ((uint32_t) GNSSbuf[(o)+3] << 24))
+#define UBX_I4(o) ((int32_t) UBX_U4(o))
+
+static void GNSS_UBX_PVT()
+{
+  static uint8_t last_second = 0xFF;
+
+  if (ubloxDataLength < 84) {
+    return;
+  }
+
+  bool date_time = ((GNSSbuf[11] & 0x03) == 0x03); /* validDate, validTime */
+  bool fix_ok    = (GNSSbuf[21] & 0x01);           /* gnssFixOK */
+  uint8_t fix    = GNSSbuf[20];                    /* 3D or GNSS + DR */
+
+  GNSS_Decoded.sats  = GNSSbuf[23];
+  GNSS_Decoded.valid = date_time && fix_ok && (fix == 3 || fix == 4);
+
+  if (!GNSS_Decoded.valid) {
+    return;
+  }
+
+  GNSS_Decoded.ms     = millis();
+  GNSS_Decoded.year   = UBX_U2(4);
+  GNSS_Decoded.month  = GNSSbuf[6];
+  GNSS_Decoded.day    = GNSSbuf[7];
+  GNSS_Decoded.hour   = GNSSbuf[8];
+  GNSS_Decoded.minute = GNSSbuf[9];
+  GNSS_Decoded.second = GNSSbuf[10];
+  GNSS_Decoded.hacc   = UBX_U4(40) / 1000.0;
+  GNSS_Decoded.vacc   = UBX_U4(44) / 1000.0;
+
+  ThisAircraft.longitude = deg7_to_deg(UBX_I4(24));
+  ThisAircraft.latitude  = deg7_to_deg(UBX_I4(28));
+  ThisAircraft.altitude  = UBX_I4(36) / 1000.0; /* above MSL */
+  ThisAircraft.geoid_separation = (UBX_I4(32) - UBX_I4(36)) / 1000.0;
+  ThisAircraft.speed  = cms_to_knots(UBX_I4(60) / 10);
+  ThisAircraft.course = UBX_I4(64) / 100000.0;
+  /* there is no HDOP in NAV-PVT, PDOP is the nearest one */
+  ThisAircraft.hdop   = UBX_U2(76);
+
+  /* velocity down is a true climb rate, unlike altitude differences */
+  int32_t climb = -UBX_I4(56) / 10;
+
+  if (hw_info.baro == BARO_MODULE_NONE) {
+    ThisAircraft.vs = cms_to_fpm(climb);
+  } else {
+    Vario_GNSS(climb);
+  }
+
+#if defined(USE_NMEALIB)
+  /* NMEA to the clients is synthesized once a second, on request only */
+  if (settings->nmea_g && GNSS_Decoded.second != last_second) {
+    ThisAircraft.timestamp = now();
+    NMEA_Position();
+  }
+#endif
+  last_second = GNSS_Decoded.second;
+}
+
+static void GNSS_UBX_TimeUTC()
+{
+  if (ubloxDataLength < 20 || !(GNSSbuf[19] & 0x04)) { /* validUTC */
+    return;
+  }
+
+  if (GNSSTimeSyncMarker == 0 || millis() - GNSSTimeSyncMarker > 60000) {
+    setTime(GNSSbuf[16], GNSSbuf[17], GNSSbuf[18],
+            GNSSbuf[15], GNSSbuf[14], UBX_U2(12));
+    GNSSTimeSyncMarker = millis();
+  }
+}
+
+static void GNSS_UBX_Parse()
+{
+  if (ubloxClass == 0x01) {         // NAV
+    if (ubloxId == 0x07) {          // PVT
+      GNSS_UBX_PVT();
+    } else if (ubloxId == 0x21) {   // TIMEUTC
+      GNSS_UBX_TimeUTC();
+    }
+  }
+}
+
 static boolean GNSS_probe() {
 
   unsigned long startTime = millis();
@@ -392,8 +555,10 @@ static boolean GNSS_probe() {
     if (swSer.available() > 0) {
       c1 = swSer.read();
       if ((c1 == '$') && (c2 == 0)) { c2 = c1; continue; }
-      if ((c2 == '$') && (c1 == 'G')) {
-        /* got $G */
+      if ((c1 == (char) 0xB5) && (c2 == 0)) { c2 = c1; continue; }
+      if (((c2 == '$') && (c1 == 'G')) ||
+          ((c2 == (char) 0xB5) && (c1 == 0x62))) {
+        /* got $G, or UBX sync when NMEA is still off since last setup */
 
         /* leave the function with GNSS port opened */
         return true;
@@ -481,6 +646,14 @@ byte GNSS_setup() {
       // Set the navigation mode (Airborne, 1G)
       // Turning off some GPS NMEA sentences on the uBlox modules
       setup_UBX();
+
+      if (rval != GNSS_MODULE_U6) {
+        if (settings->gnss_pvt) {
+          setup_UBX_PVT();
+        } else {
+          setup_UBX_NMEA();
+        }
+      }
     }
   }
 
@@ -551,6 +724,13 @@ void PickGNSSFix()
   while (true) {
     if (swSer.available() > 0) {
       c = swSer.read();
+
+      if (GNSS_Decoded.source == GNSS_DECODED_UBX_PVT) {
+        if (ubloxProcessData(c)) {
+          GNSS_UBX_Parse();
+        }
+        continue;
+      }
     } else if (Serial.available() > 0) {
       c = Serial.read();
     } else if (SoC->Bluetooth && SoC->Bluetooth->available() > 0) {
@@ -638,33 +818,63 @@ void PickGNSSFix()
  *  Algorithm of EGM96 geoid offset approximation was taken from XCSoar
  */
 
-static float AsBearing(float angle)
-{
-  float retval = angle;
+/*
+ * The table holds 90 rows of 180 nodes, 2 degrees apart, from 90N and 0E.
+ * Nearest node rounding was off by up to 18 m against the interpolated
+ * value (1 m on average), so the four nodes around own position are
+ * interpolated. They are cached, the table is read only on cell change.
+ */
+#define GEOID_ROWS  90
+#define GEOID_COLS  180
 
-  while (retval < 0)
-    retval += 360.0;
+static struct {
+  int   ilat;
+  int   ilon;
+  float node[4];  /* NW, NE, SW, SE, metres */
+} Geoid_Cell = { -1, -1 };
 
-  while (retval >= 360.0)
-    retval -= 360.0;
+static float Geoid_Node(int ilat, int ilon)
+{
+  int offset = ilat * GEOID_COLS + (ilon % GEOID_COLS);
+
+  if (offset < 0 || offset >= egm96s_dem_len)
+    return 0;
 
-  return retval;
+  return (float) ((int) pgm_read_byte(&egm96s_dem[offset]) - 127);
 }
 
-int LookupSeparation(float lat, float lon)
+float LookupSeparation(float lat, float lon)
 {
-  int ilat, ilon;
-
-  ilat = round((90.0 - lat) / 2.0);
-  ilon = round(AsBearing(lon) / 2.0);
+  float y = (90.0 - constrain(lat, -90.0, 90.0)) / 2.0;
+  float x = (lon < 0 ? lon + 360.0 : lon) / 2.0;
+
+  int ilat = (int) y;
+  int ilon = (int) x;
+
+  /* there is no row for 90S, the southernmost one stretches over it */
+  if (ilat > GEOID_ROWS - 2)
+    ilat = GEOID_ROWS - 2;
+  if (ilon > GEOID_COLS - 1)
+    ilon = GEOID_COLS - 1;
+
+  if (ilat != Geoid_Cell.ilat || ilon != Geoid_Cell.ilon) {
+    Geoid_Cell.node[0] = Geoid_Node(ilat,     ilon);
+    Geoid_Cell.node[1] = Geoid_Node(ilat,     ilon + 1);
+    Geoid_Cell.node[2] = Geoid_Node(ilat + 1, ilon);
+    Geoid_Cell.node[3] = Geoid_Node(ilat + 1, ilon + 1);
+    Geoid_Cell.ilat = ilat;
+    Geoid_Cell.ilon = ilon;
+  }
 
-  int offset = ilat * 180 + ilon;
+  float fy = y - ilat;
+  float fx = x - ilon;
 
-  if (offset >= egm96s_dem_len)
-    return 0;
+  if (fy > 1.0)
+    fy = 1.0;
 
-  if (offset < 0)
-    return 0;
+  float north = Geoid_Cell.node[0] + (Geoid_Cell.node[1] - Geoid_Cell.node[0]) * fx;
+  float south = Geoid_Cell.node[2] + (Geoid_Cell.node[3] - Geoid_Cell.node[2]) * fx;
 
-  return (int) pgm_read_byte(&egm96s_dem[offset]) - 127;
+  /* decimetres */
+  return roundf((north + (south - north) * fy) * 10.0) / 10.0;
 }
@@ -40,21 +40,59 @@ enum
  * Valid date is critical for legacy protocol (only).
  */
 #define NMEA_EXP_TIME  3500 /* 3.5 seconds */
-#define isValidGNSSFix()  ( gnss.location.isValid()               && \
+#define isValidNMEAFix()  ( gnss.location.isValid()               && \
                             gnss.altitude.isValid()               && \
                             gnss.date.isValid()                   && \
                            (gnss.location.age() <= NMEA_EXP_TIME) && \
                            (gnss.altitude.age() <= NMEA_EXP_TIME) && \
                            (gnss.date.age()     <= NMEA_EXP_TIME))
 
+/*
+ * u-blox 7 and 8 can be switched from NMEA over to binary NAV-PVT
+ * (plus NAV-TIMEUTC for the clock), decoded at GNSS_PVT_RATE_MS intervals.
+ */
+#define GNSS_PVT_RATE_MS  200 /* 5 Hz */
+
+/* who decodes the fix when TinyGPS++ of the main loop does not */
+enum
+{
+  GNSS_DECODED_NONE,
+  GNSS_DECODED_UBX_PVT,   /* u-blox NAV-PVT */
+  GNSS_DECODED_READER     /* NMEA, on the reader thread of the Raspberry Pi */
+};
+
+/*
+ * A fix decoded straight into ThisAircraft, whatever its source;
+ * the date, time and quality of it are kept here.
+ */
+typedef struct gnss_decoded_struct {
+  uint8_t       source;   /* GNSS_DECODED_... */
+  bool          valid;    /* 3D fix with valid date and time */
+  unsigned long ms;       /* when the latest fix was decoded */
+  uint16_t      year;
+  uint8_t       month;
+  uint8_t       day;
+  uint8_t       hour;
+  uint8_t       minute;
+  uint8_t       second;
+  uint8_t       sats;
+  float         hacc;     /* metres */
+  float         vacc;
+} gnss_decoded_t;
+
+#define isValidDecodedFix() ( GNSS_Decoded.valid && \
+                             (millis() - GNSS_Decoded.ms <= NMEA_EXP_TIME))
+#define isValidGNSSFix()  ( isValidNMEAFix() || isValidDecodedFix())
+
 byte GNSS_setup      (void);
 void GNSS_fini       (void);
 void GNSSTimeSync    (void);
 void PickGNSSFix     (void);
-int LookupSeparation (float, float);
+float LookupSeparation (float, float);
 
 extern TinyGPSPlus gnss;
 extern volatile unsigned long PPS_TimeMarker;
+extern gnss_decoded_t GNSS_Decoded;
 extern const char *GNSS_name[];
 
 #endif /* GNSSHELPER_H */
\ No newline at end of file
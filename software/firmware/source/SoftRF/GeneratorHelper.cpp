@@ -0,0 +1,642 @@
+/*
+ * GeneratorHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(RASPBERRY_PI)
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+
+#include "GeneratorHelper.h"
+#include "GDL90Helper.h"
+#include "RFHelper.h"
+#include "Protocol_Legacy.h"
+#include "Protocol_OGNTP.h"
+#include "Protocol_FANET.h"
+
+#define GEN_THERMAL_SIZE    8       /* aircraft sharing a thermal */
+#define GEN_THERMAL_RANGE   10000   /* m, gliders around the centre */
+#define GEN_RIDGE_RANGE     5000    /* m, paragliders around the centre */
+#define GEN_AIRWAY_RANGE    60000   /* m, airliners re-enter beyond it */
+#define GEN_THERMAL_BASE    800     /* m, a climb starts here ...      */
+#define GEN_THERMAL_TOP     2500    /* ... and glides off to the next */
+#define GEN_WIND_EAST       3.0     /* m/s, thermals drift along */
+#define GEN_WIND_NORTH      1.0
+#define GEN_OWN_ALTITUDE    300     /* m, own-ship parked at the centre */
+#define GEN_OWN_SPEED       50      /* kt, own-ship heading north in encounters */
+
+typedef struct gen_aircraft_struct {
+  ufo_t         fo;
+  float         x, y;     /* m east and north, circle centre or position */
+  float         radius;   /* m, 0 - straight flight */
+  float         phase;    /* rad, bearing from the circle centre */
+  float         omega;    /* rad/s, negative is counter-clockwise */
+  float         climb;    /* m/s */
+  unsigned long moved_ms;
+  unsigned long next_ms;  /* next report is due */
+} gen_aircraft_t;
+
+generator_stats_t Generator_Stats;
+
+static generator_config_t Gen;
+static std::vector<gen_aircraft_t> Gen_Aircraft;
+
+static int      Gen_fd        = -1;
+static bool     Gen_Datagram  = false;
+static uint8_t  Gen_Buf[GENERATOR_BUFSIZE];
+static size_t   Gen_Len       = 0;
+static size_t   Gen_Limit     = sizeof(Gen_Buf);
+static std::string Gen_RawData;
+
+static unsigned long Gen_Start_ms;
+static unsigned long Gen_Period_ms;
+static unsigned long Gen_Snapshot_ms;
+static unsigned long Gen_Heartbeat_ms;
+static unsigned long Gen_Fix_ms;
+static unsigned long Gen_Stats_ms;
+
+/*
+ * In GENERATOR_ENCOUNTER_* order: course relative to own-ship,
+ * speed in knots, miss distance in m east
+ */
+static const struct {
+  float course;
+  float speed;
+  float miss;
+} Gen_Encounters[] = {
+  {   0,  0,   0 },   /* none */
+  { 180, 50,   0 },   /* head-on */
+  { 270, 50,   0 },   /* crossing */
+  {   0, 80,  30 },   /* overtake */
+  { 180, 50, 600 },   /* pass */
+};
+
+static float Gen_Uniform(float lo, float hi)
+{
+  return lo + (hi - lo) * ((float) random() / RAND_MAX);
+}
+
+static bool Gen_Open(const char *dest)
+{
+  if (!strcmp(dest, "-")) {
+    Gen_fd = STDOUT_FILENO;
+    return true;
+  }
+
+  const char *host = strchr(dest, ':');
+  const char *port = host ? strrchr(host + 1, ':') : NULL;
+  struct addrinfo hints, *res;
+
+  if (port == NULL) {
+    return false;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+
+  if (!strncmp(dest, "udp:", 4)) {
+    hints.ai_socktype = SOCK_DGRAM;
+    Gen_Datagram = true;
+  } else if (!strncmp(dest, "tcp:", 4)) {
+    hints.ai_socktype = SOCK_STREAM;
+  } else {
+    return false;
+  }
+
+  std::string name(host + 1, port - host - 1);
+
+  if (getaddrinfo(name.c_str(), port + 1, &hints, &res) != 0) {
+    return false;
+  }
+
+  Gen_fd = socket(res->ai_family, res->ai_socktype, 0);
+  if (Gen_fd >= 0) {
+    int broadcast = 1;
+
+    setsockopt(Gen_fd, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    if (connect(Gen_fd, res->ai_addr, res->ai_addrlen) < 0) {
+      close(Gen_fd);
+      Gen_fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+
+  Gen_Limit = Gen_Datagram ? GENERATOR_UDP_BUFSIZE : sizeof(Gen_Buf);
+
+  return (Gen_fd >= 0);
+}
+
+static void Gen_Send(const uint8_t *buf, size_t size)
+{
+  while (size > 0) {
+    ssize_t n = (Gen_fd == STDOUT_FILENO ? write(Gen_fd, buf, size) :
+                                           send(Gen_fd, buf, size, MSG_NOSIGNAL));
+
+    Generator_Stats.sends++;
+
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* a refused datagram or a gone peer */
+      Generator_Stats.dropped += size;
+      return;
+    }
+
+    Generator_Stats.bytes += n;
+    buf  += n;
+    size -= n;
+  }
+}
+
+static void Gen_Flush()
+{
+  if (Gen_Len > 0) {
+    Gen_Send(Gen_Buf, Gen_Len);
+    Gen_Len = 0;
+  }
+}
+
+/* datagrams carry whole messages, so never split a chunk */
+static void Gen_Put(const void *buf, size_t size)
+{
+  if (Gen_Len + size > Gen_Limit) {
+    Gen_Flush();
+  }
+
+  if (size > Gen_Limit) {
+    Gen_Send((const uint8_t *) buf, size);
+    return;
+  }
+
+  memcpy(Gen_Buf + Gen_Len, buf, size);
+  Gen_Len += size;
+}
+
+static void Gen_Move(gen_aircraft_t *a, unsigned long ms)
+{
+  float dt = (ms - a->moved_ms) / 1000.0;
+  float east, north;
+
+  a->moved_ms = ms;
+
+  if (a->radius > 0) {
+    a->x += GEN_WIND_EAST  * dt;
+    a->y += GEN_WIND_NORTH * dt;
+    a->phase = fmodf(a->phase + a->omega * dt, 2 * PI);
+
+    a->fo.altitude += a->climb * dt;
+    if (a->fo.altitude > GEN_THERMAL_TOP) {
+      a->fo.altitude = GEN_THERMAL_BASE;
+    }
+
+    east  = a->x + a->radius * sinf(a->phase);
+    north = a->y + a->radius * cosf(a->phase);
+    a->fo.course = degrees(a->phase) + (a->omega > 0 ? 90 : -90);
+  } else {
+    float speed = a->fo.speed * _GPS_MPS_PER_KNOT;
+
+    a->x += speed * sinf(radians(a->fo.course)) * dt;
+    a->y += speed * cosf(radians(a->fo.course)) * dt;
+
+    /* leaving the scene, come back in from the opposite side */
+    if (a->x * a->x + a->y * a->y > (float) GEN_AIRWAY_RANGE * GEN_AIRWAY_RANGE) {
+      a->x = -a->x;
+      a->y = -a->y;
+    }
+
+    east  = a->x;
+    north = a->y;
+  }
+
+  a->fo.course    = fmodf(a->fo.course + 720, 360);
+  a->fo.latitude  = Gen.latitude  + north / 111320.0;
+  a->fo.longitude = Gen.longitude + east / (111320.0 * cosf(radians(Gen.latitude)));
+  a->fo.timestamp = now();
+}
+
+/* radio frames are of one protocol, the one replays and relays decode */
+static bool Gen_OnAir(gen_aircraft_t *a)
+{
+  return Gen.format == GENERATOR_FORMAT_LOG || Gen.format == GENERATOR_FORMAT_RAW ?
+         a->fo.protocol == Gen.protocol : true;
+}
+
+static void Gen_Put_Log(unsigned long ms, const char *str)
+{
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%lu %s\n", ms - Gen_Start_ms, str);
+
+  Gen_Put(line, len);
+}
+
+static void Gen_Put_NMEA(unsigned long ms, char *sentence, size_t size)
+{
+  size_t len = strlen(sentence);
+  uint8_t cs = 0;
+
+  for (size_t i = 1; i < len; i++) {
+    cs ^= sentence[i];
+  }
+  snprintf(sentence + len, size - len, "*%02X", cs);
+  Gen_Put_Log(ms, sentence);
+}
+
+/* own-ship speed in knots, north from the centre when in an encounter */
+static float Gen_Own_Speed()
+{
+  return Gen.encounter == GENERATOR_ENCOUNTER_NONE ? 0 : GEN_OWN_SPEED;
+}
+
+/* own-ship fix, every second of a log */
+static void Gen_Fix(unsigned long ms)
+{
+  char sentence[100];
+  time_t t = now();
+  float north = Gen_Own_Speed() * _GPS_MPS_PER_KNOT * (ms - Gen_Start_ms) / 1000.0;
+  float latitude = Gen.latitude + north / 111320.0;
+  float lat = fabsf(latitude);
+  float lon = fabsf(Gen.longitude);
+  char lat_s[16], lon_s[16];
+
+  snprintf(lat_s, sizeof(lat_s), "%02d%07.4f,%c", (int) lat,
+           (lat - (int) lat) * 60, latitude < 0 ? 'S' : 'N');
+  snprintf(lon_s, sizeof(lon_s), "%03d%07.4f,%c", (int) lon,
+           (lon - (int) lon) * 60, Gen.longitude < 0 ? 'W' : 'E');
+
+  snprintf(sentence, sizeof(sentence),
+           "$GPRMC,%02d%02d%02d.00,A,%s,%s,%.1f,0.0,%02d%02d%02d,,,A",
+           hour(t), minute(t), second(t), lat_s, lon_s, Gen_Own_Speed(),
+           day(t), month(t), year(t) % 100);
+  Gen_Put_NMEA(ms, sentence, sizeof(sentence));
+
+  snprintf(sentence, sizeof(sentence),
+           "$GPGGA,%02d%02d%02d.00,%s,%s,1,08,1.0,%d.0,M,0.0,M,,",
+           hour(t), minute(t), second(t), lat_s, lon_s, GEN_OWN_ALTITUDE);
+  Gen_Put_NMEA(ms, sentence, sizeof(sentence));
+}
+
+static size_t Gen_Encode(gen_aircraft_t *a, uint8_t *pkt)
+{
+  switch (a->fo.protocol)
+  {
+  case RF_PROTOCOL_LEGACY:
+    return legacy_encode(pkt, &a->fo);
+  case RF_PROTOCOL_OGNTP:
+    return ogntp_encode(pkt, &a->fo);
+  case RF_PROTOCOL_FANET:
+    return fanet_encode(pkt, &a->fo);
+  default:
+    /* 1090ES is not on the air of any SoftRF radio */
+    return 0;
+  }
+}
+
+static void Gen_Report(gen_aircraft_t *a, unsigned long ms)
+{
+  uint8_t pkt[MAX_PKT_SIZE];
+  uint8_t frame[GDL90_FRAME_SIZE(GDL90_TRAFFIC_LEN)];
+  char line[2 * MAX_PKT_SIZE + 64];
+  size_t size;
+
+  if (Gen.format == GENERATOR_FORMAT_GDL90) {
+    size = GDL90_Traffic(frame, &a->fo);
+    Gen_Put(frame, size);
+    Generator_Stats.reports++;
+    return;
+  }
+
+  if (!Gen_OnAir(a)) {
+    return;
+  }
+
+  size = Gen_Encode(a, pkt);
+  if (size == 0) {
+    return;
+  }
+
+  String hex = Bin2Hex(pkt, size);
+
+  if (Gen.format == GENERATOR_FORMAT_LOG) {
+    int len = snprintf(line, sizeof(line), "%lu $PSRFI,%lu,%s,%d\n",
+                       ms - Gen_Start_ms, (unsigned long) now(), hex.c_str(),
+                       (int) Gen_Uniform(-100, -60));
+    Gen_Put(line, len);
+  } else {
+    Gen_RawData += (Gen_RawData.empty() ? "\"" : ",\"");
+    Gen_RawData += hex.c_str();
+    Gen_RawData += "\"";
+  }
+  Generator_Stats.reports++;
+}
+
+/* what dump1090 would serve as 'aircraft.json' at this moment */
+static void Gen_Snapshot(unsigned long ms)
+{
+  std::string json;
+  char buf[320];
+
+  snprintf(buf, sizeof(buf), "{\"now\":%lu.0,\"messages\":%u,\"aircraft\":[",
+           (unsigned long) now(), Generator_Stats.reports);
+  json = buf;
+
+  for (size_t i = 0; i < Gen_Aircraft.size(); i++) {
+    gen_aircraft_t *a = &Gen_Aircraft[i];
+
+    Gen_Move(a, ms);
+
+    snprintf(buf, sizeof(buf),
+      "%s{\"hex\":\"%06x\",\"flight\":\"%.8s\",\"lat\":%.6f,\"lon\":%.6f,"
+      "\"nucp\":7,\"seen_pos\":0.1,\"altitude\":%d,\"vert_rate\":%d,"
+      "\"track\":%d,\"speed\":%d,\"messages\":%u,\"seen\":0.1,\"rssi\":%.1f}",
+      i ? "," : "", a->fo.addr, (char *) a->fo.callsign,
+      a->fo.latitude, a->fo.longitude,
+      (int) (a->fo.altitude * _GPS_FEET_PER_METER), (int) a->fo.vs,
+      (int) a->fo.course, (int) a->fo.speed, Generator_Stats.reports,
+      Gen_Uniform(-30, -5));
+    json += buf;
+
+    Generator_Stats.reports++;
+  }
+
+  json += "]}\n";
+  Gen_Put(json.data(), json.size());
+}
+
+/* keep the schedule, or skip what is a whole period behind it */
+static bool Gen_Due(unsigned long *due, unsigned long ms)
+{
+  if ((long) (ms - *due) < 0) {
+    return false;
+  }
+
+  unsigned long lag = ms - *due;
+
+  if (lag > Generator_Stats.lag_max) {
+    Generator_Stats.lag_max = lag;
+  }
+
+  if (lag >= Gen_Period_ms) {
+    Generator_Stats.late++;
+    *due = ms + Gen_Period_ms;
+  } else {
+    *due += Gen_Period_ms;
+  }
+
+  return true;
+}
+
+static void Gen_Print_Stats()
+{
+  fprintf( stderr, "Generator: %u reports, %u bytes in %u sends, "
+                   "%u bytes dropped, %u late, lag %u ms max\n",
+           Generator_Stats.reports, Generator_Stats.bytes,
+           Generator_Stats.sends, Generator_Stats.dropped,
+           Generator_Stats.late, Generator_Stats.lag_max );
+}
+
+bool Generator_setup(const generator_config_t *config)
+{
+  unsigned int count = config->gliders + config->airliners + config->paragliders;
+  float cx = 0, cy = 0;
+
+  Gen = *config;
+
+  if ((count == 0 && Gen.encounter == GENERATOR_ENCOUNTER_NONE) || Gen.rate <= 0) {
+    return false;
+  }
+
+  if (!Gen_Open(Gen.dest)) {
+    fprintf( stderr, "Unable to open %s\n", Gen.dest );
+    return false;
+  }
+
+  /* the same scene on every run */
+  srandom(1);
+  setTime(time(NULL));
+
+  Gen_Period_ms = (unsigned long) (1000 / Gen.rate);
+  Gen_Start_ms  = millis();
+
+  for (unsigned int i = 0; i < count; i++) {
+    gen_aircraft_t a;
+
+    memset(&a, 0, sizeof(a));
+
+    if (i < Gen.gliders) {
+      if (i % GEN_THERMAL_SIZE == 0) {
+        cx = Gen_Uniform(-GEN_THERMAL_RANGE, GEN_THERMAL_RANGE);
+        cy = Gen_Uniform(-GEN_THERMAL_RANGE, GEN_THERMAL_RANGE);
+      }
+      a.radius           = Gen_Uniform(60, 120);
+      a.climb            = Gen_Uniform(0.5, 3.0);
+      a.fo.speed         = Gen_Uniform(40, 55);
+      a.fo.altitude      = Gen_Uniform(GEN_THERMAL_BASE, GEN_THERMAL_TOP);
+      a.fo.protocol      = Gen.protocol;
+      a.fo.addr          = 0xDD0000 + i;
+      a.fo.addr_type     = ADDR_TYPE_FLARM;
+      a.fo.aircraft_type = AIRCRAFT_TYPE_GLIDER;
+    } else if (i < Gen.gliders + Gen.airliners) {
+      cx = Gen_Uniform(-GEN_AIRWAY_RANGE, GEN_AIRWAY_RANGE) * 0.7;
+      cy = Gen_Uniform(-GEN_AIRWAY_RANGE, GEN_AIRWAY_RANGE) * 0.7;
+      a.fo.speed         = Gen_Uniform(250, 450);
+      a.fo.course        = Gen_Uniform(0, 360);
+      a.fo.altitude      = Gen_Uniform(3000, 11500);
+      a.fo.protocol      = RF_PROTOCOL_ADSB_1090;
+      a.fo.addr          = 0x400000 + i;
+      a.fo.addr_type     = ADDR_TYPE_ICAO;
+      a.fo.aircraft_type = AIRCRAFT_TYPE_JET;
+      snprintf((char *) a.fo.callsign, sizeof(a.fo.callsign), "GEN%04u", i % 10000);
+    } else {
+      if ((i - Gen.gliders - Gen.airliners) % GEN_THERMAL_SIZE == 0) {
+        cx = Gen_Uniform(-GEN_RIDGE_RANGE, GEN_RIDGE_RANGE);
+        cy = Gen_Uniform(-GEN_RIDGE_RANGE, GEN_RIDGE_RANGE);
+      }
+      a.radius           = Gen_Uniform(30, 50);
+      a.climb            = Gen_Uniform(0.3, 1.5);
+      a.fo.speed         = Gen_Uniform(18, 24);
+      a.fo.altitude      = Gen_Uniform(GEN_THERMAL_BASE, GEN_THERMAL_TOP);
+      a.fo.protocol      = RF_PROTOCOL_FANET;
+      a.fo.addr          = 0xFB0000 + i;
+      a.fo.addr_type     = ADDR_TYPE_FANET;
+      a.fo.aircraft_type = AIRCRAFT_TYPE_PARAGLIDER;
+    }
+
+    if (a.radius > 0) {
+      a.x     = cx + Gen_Uniform(-50, 50);
+      a.y     = cy + Gen_Uniform(-50, 50);
+      a.phase = Gen_Uniform(0, 2 * PI);
+      a.omega = (random() & 1 ? 1 : -1) * a.fo.speed * _GPS_MPS_PER_KNOT / a.radius;
+      a.fo.turn = degrees(a.omega);
+    } else {
+      a.x     = cx;
+      a.y     = cy;
+    }
+    a.fo.vs = a.climb * 60 * _GPS_FEET_PER_METER;
+
+    /* spread the reports evenly over a period */
+    a.moved_ms = Gen_Start_ms;
+    a.next_ms  = Gen_Start_ms + Gen_Period_ms * i / count;
+
+    Gen_Move(&a, Gen_Start_ms);
+    Gen_Aircraft.push_back(a);
+  }
+
+  if (Gen.encounter != GENERATOR_ENCOUNTER_NONE) {
+    gen_aircraft_t a;
+    float t = GENERATOR_ENCOUNTER_CPA;
+
+    memset(&a, 0, sizeof(a));
+
+    a.fo.course        = Gen_Encounters[Gen.encounter].course;
+    a.fo.speed         = Gen_Encounters[Gen.encounter].speed;
+    a.fo.altitude      = GEN_OWN_ALTITUDE;
+    a.fo.protocol      = Gen.protocol;
+    a.fo.addr          = 0xDDE000 + Gen.encounter;
+    a.fo.addr_type     = ADDR_TYPE_FLARM;
+    a.fo.aircraft_type = AIRCRAFT_TYPE_GLIDER;
+
+    /* back from where both meet, along the course of the target */
+    float speed = a.fo.speed * _GPS_MPS_PER_KNOT;
+
+    a.x = Gen_Encounters[Gen.encounter].miss - speed * sinf(radians(a.fo.course)) * t;
+    a.y = Gen_Own_Speed() * _GPS_MPS_PER_KNOT * t -
+          speed * cosf(radians(a.fo.course)) * t;
+
+    a.moved_ms = Gen_Start_ms;
+    a.next_ms  = Gen_Start_ms;
+
+    Gen_Move(&a, Gen_Start_ms);
+    Gen_Aircraft.push_back(a);
+  }
+
+  Gen_Snapshot_ms  = Gen_Start_ms;
+  Gen_Heartbeat_ms = Gen_Start_ms - 1000;
+  Gen_Fix_ms       = Gen_Start_ms - 1000;
+  Gen_Stats_ms     = Gen_Start_ms;
+
+  unsigned int off_air = 0;
+
+  for (size_t i = 0; i < Gen_Aircraft.size(); i++) {
+    off_air += Gen_OnAir(&Gen_Aircraft[i]) ? 0 : 1;
+  }
+  if (off_air) {
+    fprintf( stderr, "Generator: %u aircraft not on %s left out\n", off_air,
+             Gen.protocol == RF_PROTOCOL_OGNTP ? "OGNTP" : "Legacy" );
+  }
+
+  /* a log replays on its own: radio protocol first, then own-ship fixes */
+  if (Gen.format == GENERATOR_FORMAT_LOG) {
+    Gen_Put_Log(Gen_Start_ms, Gen.protocol == RF_PROTOCOL_OGNTP ?
+                "{\"class\":\"SOFTRF\",\"protocol\":\"OGNTP\"}" :
+                "{\"class\":\"SOFTRF\",\"protocol\":\"LEGACY\"}");
+  }
+
+  return true;
+}
+
+bool Generator_loop()
+{
+  unsigned long ms = millis();
+  unsigned long next_ms;
+
+  if (Gen.duration_ms && ms - Gen_Start_ms >= Gen.duration_ms) {
+    return false;
+  }
+
+  if (Gen.format == GENERATOR_FORMAT_D1090) {
+    if (Gen_Due(&Gen_Snapshot_ms, ms)) {
+      Gen_Snapshot(ms);
+    }
+    next_ms = Gen_Snapshot_ms;
+  } else {
+    if (Gen.format == GENERATOR_FORMAT_GDL90 && ms - Gen_Heartbeat_ms >= 1000) {
+      uint8_t frame[GDL90_FRAME_SIZE(GDL90_HEARTBEAT_LEN)];
+
+      Gen_Put(frame, GDL90_Heartbeat(frame));
+      Gen_Heartbeat_ms = ms;
+    }
+
+    if (Gen.format == GENERATOR_FORMAT_LOG && ms - Gen_Fix_ms >= 1000) {
+      Gen_Fix(ms);
+      Gen_Fix_ms = ms;
+    }
+
+    next_ms = ms + Gen_Period_ms;
+
+    for (size_t i = 0; i < Gen_Aircraft.size(); i++) {
+      gen_aircraft_t *a = &Gen_Aircraft[i];
+
+      if (Gen_Due(&a->next_ms, ms)) {
+        Gen_Move(a, ms);
+        Gen_Report(a, ms);
+      }
+      if ((long) (a->next_ms - next_ms) < 0) {
+        next_ms = a->next_ms;
+      }
+    }
+
+    if (Gen.format == GENERATOR_FORMAT_LOG &&
+        (long) (Gen_Fix_ms + 1000 - next_ms) < 0) {
+      next_ms = Gen_Fix_ms + 1000;
+    }
+
+    if (!Gen_RawData.empty()) {
+      std::string json = "{\"rawdata\":[" + Gen_RawData + "]}\n";
+
+      Gen_Put(json.data(), json.size());
+      Gen_RawData.clear();
+    }
+  }
+
+  Gen_Flush();
+
+  if (ms - Gen_Stats_ms >= GENERATOR_STATS_MS) {
+    Gen_Print_Stats();
+    Gen_Stats_ms = ms;
+  }
+
+  ms = millis();
+  if ((long) (next_ms - ms) > 0) {
+    delay(next_ms - ms);
+  }
+
+  return true;
+}
+
+void Generator_fini()
+{
+  Gen_Flush();
+
+  if (Gen_fd > STDOUT_FILENO) {
+    close(Gen_fd);
+  }
+  Gen_fd = -1;
+
+  Gen_Print_Stats();
+}
+
+#endif /* RASPBERRY_PI */
@@ -0,0 +1,86 @@
+/*
+ * GeneratorHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERATORHELPER_H
+#define GENERATORHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Synthetic traffic for load tests of receivers and exporters:
+ * gliders circling in drifting thermals, airliners en route and
+ * paragliders, encoded by the same code SoftRF transmits and exports with.
+ */
+enum
+{
+  GENERATOR_FORMAT_LOG,     /* settings, own-ship NMEA and "<ms> $PSRFI,..."
+                               lines, as replayed by -r */
+  GENERATOR_FORMAT_RAW,     /* {"rawdata":[...]} JSON, radio frames to relay */
+  GENERATOR_FORMAT_D1090,   /* 'aircraft.json' snapshots of dump1090 */
+  GENERATOR_FORMAT_GDL90    /* heartbeat and traffic reports */
+};
+
+/*
+ * One scripted target on a straight line, closest to own-ship
+ * GENERATOR_ENCOUNTER_CPA seconds into the scene, own-ship flying north.
+ */
+enum
+{
+  GENERATOR_ENCOUNTER_NONE,
+  GENERATOR_ENCOUNTER_HEAD_ON,    /* opposite course, collision */
+  GENERATOR_ENCOUNTER_CROSSING,   /* from the right, collision */
+  GENERATOR_ENCOUNTER_OVERTAKE,   /* faster, from behind, 30 m abeam */
+  GENERATOR_ENCOUNTER_PASS        /* opposite course, 600 m abeam */
+};
+
+#define GENERATOR_ENCOUNTER_CPA 30  /* seconds */
+
+#define GENERATOR_BUFSIZE       65536
+#define GENERATOR_UDP_BUFSIZE   1472  /* Ethernet MTU less IP/UDP headers */
+#define GENERATOR_STATS_MS      10000
+
+typedef struct generator_config_struct {
+  unsigned int  gliders;
+  unsigned int  airliners;
+  unsigned int  paragliders;
+  float         latitude;     /* centre of the scene */
+  float         longitude;
+  uint8_t       protocol;     /* of the gliders, RF_PROTOCOL_LEGACY or _OGNTP */
+  uint8_t       format;
+  uint8_t       encounter;
+  float         rate;         /* reports per second of each aircraft */
+  unsigned long duration_ms;  /* 0 - until interrupted */
+  const char    *dest;        /* "-", "udp:host:port" or "tcp:host:port" */
+} generator_config_t;
+
+typedef struct generator_stats_struct {
+  uint32_t reports;   /* aircraft reports encoded */
+  uint32_t bytes;     /* handed over to the destination */
+  uint32_t sends;     /* write or send calls */
+  uint32_t dropped;   /* bytes refused by the destination */
+  uint32_t late;      /* reports due a whole period ago or more */
+  uint32_t lag_max;   /* ms behind schedule */
+} generator_stats_t;
+
+bool Generator_setup(const generator_config_t *);
+bool Generator_loop(void);
+void Generator_fini(void);
+
+extern generator_stats_t Generator_Stats;
+
+#endif /* GENERATORHELPER_H */
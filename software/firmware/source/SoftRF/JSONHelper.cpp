@@ -32,6 +32,9 @@
 #include "GDL90Helper.h"
 #include "D1090Helper.h"
 #include "JSONHelper.h"
+#include "OutputHelper.h"
+#include "RelayHelper.h"
+#include "LinkHelper.h"
 
 #include <iostream>
 #include <sstream>
@@ -39,12 +42,15 @@
 #include <locale>
 #include <iomanip>
 
+#include "TCPServer.h"
+
 StaticJsonBuffer<JSON_BUFFER_SIZE> jsonBuffer;
 
 bool hasValidGPSDFix = false;
 
 extern eeprom_t eeprom_block;
 extern settings_t *settings;
+extern TCPServer Traffic_TCP_Server;
 
 byte getVal(char c)
 {
@@ -54,26 +60,137 @@ byte getVal(char c)
      return (byte)(toupper(c)-'A'+10);
 }
 
-void JSON_Export()
+#define isTimeToJSONExport() (millis() - JSON_ExportTimeMarker >= \
+                              EXPORT_INTERVAL_MS(settings->json_rate))
+static unsigned long JSON_ExportTimeMarker = 0;
+
+static void JSON_Out(uint8_t out, byte *buf, size_t size)
 {
-  if (settings->json != JSON_PING) {
-    return;
+  switch (out)
+  {
+  case JSON_OUT_UDP:
+    SoC->WiFi_transmit_UDP(JSON_DST_UDP_PORT, buf, size);
+    break;
+  case JSON_OUT_TCP:
+    Traffic_TCP_Server.Send(string((char *) buf, size));
+    break;
+  case JSON_OUT_STDOUT:
+  default:
+    Output_Write(OUTPUT_SERIAL, buf, size);
+    break;
   }
+}
+
+/* CBOR data item header: major type and its argument, shortest form */
+static uint8_t *cbor_head(uint8_t *p, uint8_t major, uint64_t val)
+{
+  major <<= 5;
+
+  if (val < 24) {
+    *p++ = major | val;
+  } else if (val <= 0xFF) {
+    *p++ = major | 24;
+    *p++ = val;
+  } else if (val <= 0xFFFF) {
+    *p++ = major | 25;
+    *p++ = val >> 8;
+    *p++ = val;
+  } else if (val <= 0xFFFFFFFFUL) {
+    *p++ = major | 26;
+    *p++ = val >> 24;
+    *p++ = val >> 16;
+    *p++ = val >> 8;
+    *p++ = val;
+  } else {
+    *p++ = major | 27;
+    for (int i = 56; i >= 0; i -= 8) {
+      *p++ = val >> i;
+    }
+  }
+
+  return p;
+}
+
+static uint8_t *cbor_int(uint8_t *p, int64_t val)
+{
+  return val < 0 ? cbor_head(p, 1, (uint64_t) (-1 - val)) :
+                   cbor_head(p, 0, (uint64_t) val);
+}
+
+#define cbor_array(p, n)        cbor_head(p, 4, n)
+#define cbor_array_begin(p)     (*(p) = 0x9F, (p) + 1)
+#define cbor_break(p)           (*(p) = 0xFF, (p) + 1)
+
+/* returns the size of the CBOR item, 0 when there is no aircraft to report */
+size_t CBOR_Encode(uint8_t *buffer)
+{
+  uint8_t *p = buffer;
+  time_t this_moment = now();
+  bool has_aircraft = false;
+
+  p = cbor_array(p, 3);
+  p = cbor_int(p, CBOR_SCHEMA_VERSION);
+  p = cbor_int(p, this_moment);
+  p = cbor_array_begin(p);
+
+  int slots[MAX_TRACKING_OBJECTS];
+  int count = Traffic_Query_Radius(ALARM_ZONE_NONE, 0, slots, MAX_TRACKING_OBJECTS);
+
+  for (int k=0; k < count; k++) {
+    int i = slots[k];
+
+    if (Container[i].addr && (this_moment - Container[i].timestamp) <= EXPORT_EXPIRATION_TIME &&
+        Traffic_NeedsExport(i, EXPORT_SINK_JSON)) {
+
+      ufo_t *fop = &Container[i];
+
+      p = cbor_array(p, CBOR_AIRCRAFT_FIELDS);
+      p = cbor_int(p, fop->addr);
+      p = cbor_int(p, fop->addr_type);
+      p = cbor_int(p, fop->protocol);
+      p = cbor_int(p, fop->aircraft_type);
+      p = cbor_int(p, deg_to_deg7(fop->latitude));
+      p = cbor_int(p, deg_to_deg7(fop->longitude));
+      p = cbor_int(p, (int32_t) (fop->altitude  * 1000));
+      p = cbor_int(p, (int32_t) (fop->course    * 100));
+      p = cbor_int(p, knots_to_cms(fop->speed));
+      p = cbor_int(p, fpm_to_cms(fop->vs));
+      p = cbor_int(p, fop->timestamp);
+
+      has_aircraft = true;
+    }
+  }
+
+  p = cbor_break(p);
 
+  return has_aircraft ? p - buffer : 0;
+}
+
+/*
+ * PingStation JSON line into buffer, returns its size with the trailing
+ * newline, 0 when there is no aircraft to report
+ */
+size_t PING_Encode(char *buffer, size_t size)
+{
   float distance;
   time_t this_moment = now();
-  char buffer[3 * 80 * MAX_TRACKING_OBJECTS];
   bool has_aircraft = false;
 
   JsonObject& root = jsonBuffer.createObject();
   JsonArray& aircraft_array = root.createNestedArray("aircraft");
 
-  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+  int slots[MAX_TRACKING_OBJECTS];
+  int count = Traffic_Query_Radius(ALARM_ZONE_NONE, 0, slots, MAX_TRACKING_OBJECTS);
+
+  for (int k=0; k < count; k++) {
+    int i = slots[k];
+
     if (Container[i].addr && (this_moment - Container[i].timestamp) <= EXPORT_EXPIRATION_TIME) {
 
       distance = Container[i].distance;
 
-      if (distance < ALARM_ZONE_NONE) {
+      if (distance < ALARM_ZONE_NONE &&
+          Traffic_NeedsExport(i, EXPORT_SINK_JSON)) {
 
         char hexbuf[8];
         char callsign[8+1];
@@ -109,17 +226,57 @@ void JSON_Export()
         strftime(timebuf, sizeof(timebuf), "%FT%T:00000000Z", gmtime(&timestamp));
         aircraft["timeStamp"] = timebuf;
 
+        /* reception of the aircraft over the radio */
+        if (Link_Stats[i].addr == Container[i].addr) {
+          JsonObject& link = aircraft.createNestedObject("link");
+
+          link["rssi"] = Link_Rssi(i);
+          link["packetsPerMin"] = Link_Rate(i);
+          link["lossPct"] = Link_Loss(i);
+          link["gapMaxMS"] = Link_Stats[i].gap_max;
+          link["corrected"] = Link_Stats[i].corrected;
+        }
+
         has_aircraft = true;
       }
     }
   }
 
+  size_t len = 0;
+
   if (has_aircraft) {
-    root.printTo(buffer);
-    Serial.println(buffer);
+    len = root.printTo(buffer, size - 1);
+    buffer[len++] = '\n';
   }
 
   jsonBuffer.clear();
+
+  return len;
+}
+
+void JSON_Export()
+{
+  if (settings->json == JSON_OFF || !isTimeToJSONExport()) {
+    return;
+  }
+  JSON_ExportTimeMarker = millis();
+
+  if (settings->json == JSON_CBOR) {
+    static uint8_t buffer[CBOR_BUFFER_SIZE];  /* sized on the table */
+    size_t size = CBOR_Encode(buffer);
+
+    /* parseSettings() refuses CBOR on stdout */
+    if (size > 0 && settings->json_out != JSON_OUT_STDOUT) {
+      JSON_Out(settings->json_out, buffer, size);
+    }
+  } else {
+    static char buffer[PING_BUFFER_SIZE];
+    size_t size = PING_Encode(buffer, sizeof(buffer));
+
+    if (size > 0) {
+      JSON_Out(settings->json_out, (byte *) buffer, size);
+    }
+  }
 }
 
 void parsePING(JsonObject& root)
@@ -210,43 +367,7 @@ void parsePING(JsonObject& root)
         fo.no_track = false;
         fo.rssi = 0;
 
-        int j;
-
-        /* Try to find and update an entry with the same aircraft ID */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == fo.addr && Container[j].protocol == fo.protocol) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
-        }
-
-        /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
-        }
-
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
+        Traffic_Add(&fo);
       }
     }
 
@@ -330,6 +451,31 @@ void parseTPV(JsonObject& root)
   }
 }
 
+static bool parseExportRate(JsonVariant rate, uint8_t *value)
+{
+  if (rate.success()) {
+    const char * rate_s = rate.as<char*>();
+    if (!strcmp(rate_s,"0.2HZ")) {
+      *value = EXPORT_RATE_0_2HZ;
+    } else if (!strcmp(rate_s,"0.5HZ")) {
+      *value = EXPORT_RATE_0_5HZ;
+    } else if (!strcmp(rate_s,"1HZ")) {
+      *value = EXPORT_RATE_1HZ;
+    } else if (!strcmp(rate_s,"2HZ")) {
+      *value = EXPORT_RATE_2HZ;
+    } else if (!strcmp(rate_s,"5HZ")) {
+      *value = EXPORT_RATE_5HZ;
+    } else if (!strcmp(rate_s,"10HZ")) {
+      *value = EXPORT_RATE_10HZ;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  return false;
+}
+
 void parseSettings(JsonObject& root)
 {
   JsonVariant mode = root["mode"];
@@ -417,6 +563,10 @@ void parseSettings(JsonObject& root)
       eeprom_block.field.settings.alarm = TRAFFIC_ALARM_DISTANCE;
     } else if (!strcmp(alarm_s,"VECTOR")) {
       eeprom_block.field.settings.alarm = TRAFFIC_ALARM_VECTOR;
+    } else if (!strcmp(alarm_s,"LEGACY")) {
+      eeprom_block.field.settings.alarm = TRAFFIC_ALARM_LEGACY;
+    } else if (!strcmp(alarm_s,"TURN")) {
+      eeprom_block.field.settings.alarm = TRAFFIC_ALARM_TURN;
     }
   }
 
@@ -510,6 +660,9 @@ void parseSettings(JsonObject& root)
     }
   }
 
+  uint8_t json_was     = eeprom_block.field.settings.json;
+  uint8_t json_out_was = eeprom_block.field.settings.json_out;
+
   JsonVariant json = root["json"];
   if (json.success()) {
     const char * json_s = json.as<char*>();
@@ -517,9 +670,47 @@ void parseSettings(JsonObject& root)
       eeprom_block.field.settings.json = JSON_OFF;
     } else if (!strcmp(json_s,"PING")) {
       eeprom_block.field.settings.json = JSON_PING;
+    } else if (!strcmp(json_s,"CBOR")) {
+      eeprom_block.field.settings.json = JSON_CBOR;
+    }
+  }
+
+  JsonVariant json_out = root["json_out"];
+  if (json_out.success()) {
+    const char * json_out_s = json_out.as<char*>();
+    if (!strcmp(json_out_s,"STDOUT")) {
+      eeprom_block.field.settings.json_out = JSON_OUT_STDOUT;
+    } else if (!strcmp(json_out_s,"UDP")) {
+      eeprom_block.field.settings.json_out = JSON_OUT_UDP;
+    } else if (!strcmp(json_out_s,"TCP")) {
+      eeprom_block.field.settings.json_out = JSON_OUT_TCP;
     }
   }
 
+  /* binary CBOR would corrupt the NMEA text on stdout */
+  if (eeprom_block.field.settings.json     == JSON_CBOR &&
+      eeprom_block.field.settings.json_out == JSON_OUT_STDOUT) {
+    fprintf( stderr, "Settings: CBOR export needs json_out UDP or TCP, "
+                     "json and json_out left unchanged\n" );
+    eeprom_block.field.settings.json     = json_was;
+    eeprom_block.field.settings.json_out = json_out_was;
+  }
+
+  parseExportRate(root["rate"]["nmea"],  &eeprom_block.field.settings.nmea_rate);
+  parseExportRate(root["rate"]["gdl90"], &eeprom_block.field.settings.gdl90_rate);
+  parseExportRate(root["rate"]["d1090"], &eeprom_block.field.settings.d1090_rate);
+  parseExportRate(root["rate"]["json"],  &eeprom_block.field.settings.json_rate);
+
+  JsonVariant delta = root["delta"];
+  if (delta.success()) {
+    eeprom_block.field.settings.export_delta = delta.as<bool>();
+  }
+
+  JsonVariant pvt = root["pvt"];
+  if (pvt.success()) {
+    eeprom_block.field.settings.gnss_pvt = pvt.as<bool>();
+  }
+
   JsonVariant stealth = root["stealth"];
   if (stealth.success()) {
     eeprom_block.field.settings.stealth = stealth.as<bool>();
@@ -609,43 +800,7 @@ void parseD1090(JsonObject& root)
         fo.no_track = false;
         fo.rssi = aircraft_array[i].rssi;
 
-        int j;
-
-        /* Try to find and update an entry with the same aircraft ID */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == fo.addr && Container[j].protocol == fo.protocol) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
-        }
-
-        /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
-        }
-
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            Traffic_Update(j);
-            break;
-          }
-        }
+        Traffic_Add(&fo);
       }
     }
 
@@ -674,73 +829,48 @@ void parseD1090(JsonObject& root)
 
 void parseRAW(JsonObject& root)
 {
+  /* raw frames are of use to the relay only */
+  if (settings->mode != SOFTRF_MODE_RELAY) {
+    return;
+  }
 
   JsonArray& rawdata = root["rawdata"];
 
   int size = rawdata.size();
-  time_t timestamp = now();
-
-  if (size > 0) {
 
-    for (int i=0; i < size; i++) {
-      const char* data = rawdata[i];
-      size_t data_len = strlen(data);
-      if (data_len > 0) {
-
-        fo = EmptyFO;
-
-        if (data_len > 2 * MAX_PKT_SIZE) {
-          data_len = 2 * MAX_PKT_SIZE;
-        }
-
-        if (data_len > 2 * sizeof(fo.raw)) {
-          data_len = 2 * sizeof(fo.raw);
-        }
+  for (int i=0; i < size; i++) {
+    const char* data = rawdata[i];
+    size_t data_len = strlen(data);
+    byte buf[MAX_PKT_SIZE];
 
-        for(int j = 0; j < data_len ; j+=2)
-        {
-          fo.raw[j>>1] = getVal(data[j+1]) + (getVal(data[j]) << 4);
-        }
-
-        fo.timestamp = timestamp;
-        fo.protocol = RF_PROTOCOL_ADSB_1090;
+    if (data_len > 2 * MAX_PKT_SIZE) {
+      data_len = 2 * MAX_PKT_SIZE;
+    }
 
-        int j;
+    for(int j = 0; j < data_len ; j+=2)
+    {
+      buf[j>>1] = getVal(data[j+1]) + (getVal(data[j]) << 4);
+    }
 
-        /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            break;
-          }
-        }
+    size_t pkt_size = data_len / 2;
+    uint32_t addr = 0;
 
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
-        }
+    /* with its address, a newer frame of the aircraft replaces a pending one */
+    if (protocol_decode && pkt_size == RF_Payload_Size(settings->rf_protocol)) {
+      byte pkt[MAX_PKT_SIZE];
+      ufo_t rfo = EmptyFO;
+      ufo_t own = ThisAircraft;
 
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            break;
-          }
-        }
-      }
-    }
+      own.timestamp = now();
+      memcpy(pkt, buf, pkt_size);   /* decoders work in place */
 
-#if 0
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (memcmp(Container[i].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) != 0) {
-        size_t size = RF_Payload_Size(settings->rf_protocol);
-        size = size > sizeof(Container[i].raw) ? sizeof(Container[i].raw) : size;
-        String str = Bin2Hex(Container[i].raw, size);
-        printf("%s\n", str.c_str());
+      if ((*protocol_decode)((void *) pkt, &own, &rfo)) {
+        addr = rfo.addr;
       }
     }
-#endif
 
+    /* raw frames go into relay queue in binary form, as is */
+    Relay_Enqueue(buf, pkt_size, settings->rf_protocol, addr, 0);
   }
 }
 
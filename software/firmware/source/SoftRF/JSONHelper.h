@@ -28,9 +28,44 @@
 enum
 {
 	JSON_OFF,
-	JSON_PING
+	JSON_PING,
+	JSON_CBOR
 };
 
+enum
+{
+	JSON_OUT_STDOUT,
+	JSON_OUT_UDP,
+	JSON_OUT_TCP
+};
+
+/*
+ * CBOR traffic export (RFC 7049), fixed schema:
+ *
+ * [ version, timestamp, [_ aircraft, aircraft, ... ] ]
+ *
+ * aircraft := [ addr, addr_type, protocol, aircraft_type,
+ *               latitude, longitude,     (1e-7 degrees)
+ *               altitude,                (millimetres, geometric)
+ *               course,                  (centi-degrees)
+ *               speed, vs,               (cm/s)
+ *               timestamp ]
+ *
+ * The aircraft list is an indefinite-length array.
+ * Being binary, CBOR needs json_out UDP or TCP: parseSettings() refuses
+ * it on STDOUT, where the NMEA text goes.
+ */
+#define CBOR_SCHEMA_VERSION   1
+#define CBOR_AIRCRAFT_FIELDS  11
+#define CBOR_MAX_ITEM_SIZE    9   /* initial byte + 64-bit argument */
+#define CBOR_BUFFER_SIZE      (4 * CBOR_MAX_ITEM_SIZE + \
+                               MAX_TRACKING_OBJECTS * \
+                               (1 + CBOR_AIRCRAFT_FIELDS * CBOR_MAX_ITEM_SIZE))
+
+#define PING_BUFFER_SIZE      (5 * 80 * MAX_TRACKING_OBJECTS)
+
+#define JSON_DST_UDP_PORT     30009
+
 struct dump1090_aircraft_struct {
   const char* hex;
   const char* squawk;
@@ -72,6 +107,8 @@ extern StaticJsonBuffer<JSON_BUFFER_SIZE> jsonBuffer;
 extern bool hasValidGPSDFix;
 
 extern void JSON_Export();
+extern size_t CBOR_Encode(uint8_t *);
+extern size_t PING_Encode(char *, size_t);
 extern void parseTPV(JsonObject&);
 extern void parseSettings(JsonObject&);
 extern void parseD1090(JsonObject&);
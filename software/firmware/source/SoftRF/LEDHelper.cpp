@@ -147,7 +147,9 @@ void LED_DisplayTraffic() {
   if (settings->pointer != LED_OFF) {
     LED_Clear_noflush();
 
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    /* least relevant first, so that the top ranked targets paint over */
+    for (int r=Traffic_Ranked - 1; r >= 0; r--) {
+      int i = Traffic_Ranking[r];
 
       if (Container[i].addr && (now() - Container[i].timestamp) <= LED_EXPIRATION_TIME) {
 
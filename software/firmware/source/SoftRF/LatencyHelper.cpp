@@ -0,0 +1,134 @@
+/*
+ * LatencyHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyHelper.h"
+#include "NMEAHelper.h"
+#include "EEPROMHelper.h"
+#include "MetricsHelper.h"
+
+latency_hist_t Latency[LATENCY_COUNT];
+
+static const char *Latency_Name[LATENCY_COUNT] = {
+  [LATENCY_DECODE]  = "DEC",
+  [LATENCY_TRAFFIC] = "TRF",
+  [LATENCY_EXPORT]  = "EXP",
+  [LATENCY_LOOP]    = "LOOP"
+};
+
+static uint32_t Latency_Loop_us = 0;
+static unsigned long Latency_ReportTimeMarker = 0;
+
+/* the percentile counts only, the totals stay monotonic */
+static void Latency_Halve(latency_hist_t *h)
+{
+  h->count = 0;
+  for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+    h->bucket[b] >>= 1;
+    h->count += h->bucket[b];
+  }
+}
+
+void Latency_Add(uint8_t stage, uint32_t us)
+{
+  latency_hist_t *h = &Latency[stage];
+  uint32_t v = us / LATENCY_MIN_US;
+  uint8_t b = 0;
+
+  if (h->count >= LATENCY_HALVE_COUNT) {
+    Latency_Halve(h);
+  }
+
+  while (v > 0 && b < LATENCY_BUCKETS - 1) {
+    v >>= 1;
+    b++;
+  }
+
+  h->bucket[b]++;
+  h->count++;
+  h->total_bucket[b]++;
+  h->total++;
+  h->sum_us += us;
+  if (us > h->max_us) {
+    h->max_us = us;
+  }
+}
+
+/* the first export of a received packet, whichever sink it is */
+void Latency_Export(ufo_t *fop)
+{
+  if (fop->rx_us) {
+    Latency_Add(LATENCY_EXPORT, micros() - fop->rx_us);
+    fop->rx_us = 0;
+  }
+}
+
+/* upper bound of the bucket holding the percentile, in microseconds */
+uint32_t Latency_Percentile(uint8_t stage, uint8_t pct)
+{
+  latency_hist_t *h = &Latency[stage];
+  uint32_t rank = (uint32_t) (((uint64_t) h->count * pct + 99) / 100);
+  uint32_t sum = 0;
+
+  if (h->count == 0) {
+    return 0;
+  }
+
+  for (uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+    sum += h->bucket[b];
+    if (sum >= rank) {
+      uint32_t bound = (uint32_t) LATENCY_MIN_US << b;
+
+      return bound < h->max_us ? bound : h->max_us;
+    }
+  }
+
+  return h->max_us;
+}
+
+void Latency_loop()
+{
+  uint32_t us = micros();
+
+  if (Latency_Loop_us) {
+    Latency_Add(LATENCY_LOOP, us - Latency_Loop_us);
+
+    if (us - Latency_Loop_us > METRICS_LOOP_OVERRUN_MS * 1000UL) {
+      METRIC_INC(loop_overruns);
+    }
+  }
+  Latency_Loop_us = us;
+
+  if (settings->nmea_p &&
+      millis() - Latency_ReportTimeMarker > LATENCY_REPORT_MS) {
+
+    for (uint8_t i = 0; i < LATENCY_COUNT; i++) {
+      snprintf_P(NMEABuffer, sizeof(NMEABuffer),
+              PSTR("$PSRFS,%s,%lu,%lu,%lu,%lu*"), Latency_Name[i],
+              (unsigned long) Latency[i].count,
+              (unsigned long) Latency_Percentile(i, 50),
+              (unsigned long) Latency_Percentile(i, 95),
+              (unsigned long) Latency[i].max_us);
+
+      NMEA_add_checksum(NMEABuffer, sizeof(NMEABuffer) - strlen(NMEABuffer));
+
+      NMEA_Out((byte *) NMEABuffer, strlen(NMEABuffer), false);
+    }
+
+    Latency_ReportTimeMarker = millis();
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * LatencyHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYHELPER_H
+#define LATENCYHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Latency of received traffic, counted from RF_Receive() picking up the
+ * packet to its decoding, its update in Container[] and its first export
+ * in $PFLAA or a GDL90 traffic report; and the main loop iteration time.
+ * Each one is a histogram of power-of-two buckets of microseconds.
+ * The counts for the percentiles are halved once they reach
+ * LATENCY_HALVE_COUNT samples, so that older samples weigh less and nothing
+ * overflows. The totals of the metrics are 64 bit and never go down.
+ */
+enum
+{
+  LATENCY_DECODE,
+  LATENCY_TRAFFIC,
+  LATENCY_EXPORT,
+  LATENCY_LOOP,
+  LATENCY_COUNT
+};
+
+#define LATENCY_MIN_US        64    /* upper bound of the first bucket ... */
+#define LATENCY_BUCKETS       16    /* ... the last one is open, 1 s and up */
+#define LATENCY_REPORT_MS     10000
+#define LATENCY_HALVE_COUNT   (1UL << 20)
+
+typedef struct latency_hist_struct {
+  uint32_t count;                         /* decayed, for the percentiles */
+  uint32_t max_us;
+  uint32_t bucket[LATENCY_BUCKETS];
+  uint64_t total;                         /* since boot, for the metrics */
+  uint64_t sum_us;
+  uint64_t total_bucket[LATENCY_BUCKETS];
+} latency_hist_t;
+
+void Latency_Add(uint8_t, uint32_t);
+void Latency_Export(ufo_t *);
+uint32_t Latency_Percentile(uint8_t, uint8_t);
+void Latency_loop(void);
+
+extern latency_hist_t Latency[LATENCY_COUNT];
+
+#endif /* LATENCYHELPER_H */
@@ -0,0 +1,144 @@
+/*
+ * LinkHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkHelper.h"
+#include "RFHelper.h"
+#include "TrafficHelper.h"
+
+link_stats_t Link_Stats[MAX_TRACKING_OBJECTS];
+link_range_t Link_Range[LINK_PROTOCOLS][LINK_RANGE_BINS];
+
+static uint32_t Link_Distance_Max[LINK_PROTOCOLS];
+
+static uint8_t Link_Bin(float distance)
+{
+  uint8_t bin = 0;
+  float edge = LINK_RANGE_FIRST;
+
+  while (distance >= edge && bin < LINK_RANGE_BINS - 1) {
+    edge *= 2;
+    bin++;
+  }
+
+  return bin;
+}
+
+/* account a packet of 'fop', stored into Container[ndx] */
+void Link_Add(int ndx, ufo_t *fop, uint8_t errors)
+{
+  link_stats_t *ls = &Link_Stats[ndx];
+  ufo_t *cp = &Container[ndx];
+  unsigned long ms = millis();
+
+  /* fused tracks are accounted under the address of the slot */
+  if (ls->addr != cp->addr) {
+    memset(ls, 0, sizeof(link_stats_t));
+    ls->addr = cp->addr;
+  } else {
+    unsigned long gap = ms - ls->last_ms;
+
+    if (gap > 0xFFFF) {
+      gap = 0xFFFF;
+    }
+    ls->head = (ls->head + 1) % LINK_GAP_COUNT;
+    ls->gap[ls->head] = gap;
+    if (ls->count < LINK_GAP_COUNT) {
+      ls->count++;
+    }
+    if (gap > ls->gap_max) {
+      ls->gap_max = gap;
+    }
+  }
+
+  ls->last_ms = ms;
+  if (ls->packets < 0xFFFF) {
+    ls->packets++;
+  }
+  ls->corrected = (ls->corrected + errors > 0xFFFF) ? 0xFFFF :
+                  ls->corrected + errors;
+
+  if (fop->protocol < LINK_PROTOCOLS &&
+      cp->distance > Link_Distance_Max[fop->protocol]) {
+    Link_Distance_Max[fop->protocol] = cp->distance;
+  }
+
+  /* 0 dBm is what radios without RSSI report */
+  if (fop->rssi == 0) {
+    return;
+  }
+
+  int16_t rssi = fop->rssi * 16;
+
+  ls->rssi = ls->rssi ? ls->rssi + (rssi - ls->rssi) / LINK_RSSI_WEIGHT : rssi;
+
+  if (fop->protocol < LINK_PROTOCOLS) {
+    link_range_t *lr = &Link_Range[fop->protocol][Link_Bin(cp->distance)];
+
+    lr->count++;
+    lr->rssi_sum += fop->rssi;
+  }
+}
+
+/* dBm, 0 when not known */
+int Link_Rssi(int ndx)
+{
+  int16_t rssi = Link_Stats[ndx].rssi;
+
+  return (rssi + (rssi < 0 ? -8 : 8)) / 16;
+}
+
+/*
+ * Packets per minute over the gaps in the ring and the time since the
+ * last packet, so that the rate of an aircraft gone silent decays
+ */
+uint16_t Link_Rate(int ndx)
+{
+  link_stats_t *ls = &Link_Stats[ndx];
+  uint32_t span = millis() - ls->last_ms;
+
+  if (ls->count == 0) {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < ls->count; i++) {
+    span += ls->gap[(ls->head + LINK_GAP_COUNT - i) % LINK_GAP_COUNT];
+  }
+
+  return span ? (uint32_t) ls->count * 60000UL / span : 0;
+}
+
+/* percent of the packets the TX interval of the protocol promises */
+uint8_t Link_Loss(int ndx)
+{
+  const rf_proto_desc_t *rf = RF_Protocol_Desc(Container[ndx].protocol);
+  uint16_t rate = Link_Rate(ndx);
+
+  if (rf == NULL || Link_Stats[ndx].count == 0) {
+    return 0;
+  }
+
+  uint32_t expected = 2 * 60000UL / (rf->tx_interval_min + rf->tx_interval_max);
+
+  return rate >= expected ? 0 : 100 - rate * 100 / expected;
+}
+
+/* metres, farthest aircraft heard on the protocol */
+uint32_t Link_Range_Max(uint8_t protocol)
+{
+  return protocol < LINK_PROTOCOLS ? Link_Distance_Max[protocol] : 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * LinkHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINKHELPER_H
+#define LINKHELPER_H
+
+#include "SoftRF.h"
+#include "SoCHelper.h"
+
+#include <protocol.h>
+
+/*
+ * Reception statistics of every aircraft heard over the radio, kept next
+ * to its Container[] slot: a smoothed RSSI, the gaps between the last
+ * LINK_GAP_COUNT packets (for the packet rate and, against the TX interval
+ * of the protocol, the loss) and the errors corrected by FEC.
+ * Every protocol also has a range curve: mean RSSI per distance bin,
+ * bins double in width from LINK_RANGE_FIRST metres on.
+ */
+#define LINK_GAP_COUNT      16
+#define LINK_RSSI_WEIGHT    8     /* EWMA, 1/8 of each new sample */
+#define LINK_RANGE_BINS     8
+#define LINK_RANGE_FIRST    500   /* metres */
+#define LINK_PROTOCOLS      (RF_PROTOCOL_FANET + 1)
+#define LINK_PAGE_SIZE      4096  /* "/link" of the web server */
+
+typedef struct link_stats_struct {
+  uint32_t      addr;       /* of the Container[] slot, 0 - unused */
+  unsigned long last_ms;    /* millis() of the last packet */
+  int16_t       rssi;       /* 1/16 dBm, smoothed, 0 - none reported */
+  uint16_t      packets;
+  uint16_t      corrected;  /* bits (UAT: RS symbols) corrected by FEC */
+  uint16_t      gap_max;    /* ms */
+  uint16_t      gap[LINK_GAP_COUNT];  /* ms, ring */
+  uint8_t       head;
+  uint8_t       count;
+} link_stats_t;
+
+typedef struct link_range_struct {
+  uint32_t  count;
+  int32_t   rssi_sum;       /* dBm */
+} link_range_t;
+
+void     Link_Add(int, ufo_t *, uint8_t);
+int      Link_Rssi(int);
+uint16_t Link_Rate(int);
+uint8_t  Link_Loss(int);
+uint32_t Link_Range_Max(uint8_t);
+
+extern link_stats_t Link_Stats[MAX_TRACKING_OBJECTS];
+extern link_range_t Link_Range[LINK_PROTOCOLS][LINK_RANGE_BINS];
+
+#endif /* LINKHELPER_H */
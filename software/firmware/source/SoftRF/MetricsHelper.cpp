@@ -0,0 +1,226 @@
+/*
+ * MetricsHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+
+#include "MetricsHelper.h"
+#include "LatencyHelper.h"
+#include "OutputHelper.h"
+#include "RelayHelper.h"
+#include "AirtimeHelper.h"
+
+extern uint32_t tx_packets_counter, rx_packets_counter;
+
+metrics_t Metrics;
+
+static const char * const Metric_Protocol[METRICS_PROTOCOLS] = {
+  [RF_PROTOCOL_LEGACY]    = "legacy",
+  [RF_PROTOCOL_OGNTP]     = "ogntp",
+  [RF_PROTOCOL_P3I]       = "p3i",
+  [RF_PROTOCOL_ADSB_1090] = "adsb1090",
+  [RF_PROTOCOL_ADSB_UAT]  = "uat",
+  [RF_PROTOCOL_FANET]     = "fanet"
+};
+
+static const char * const Metric_Output[OUTPUT_COUNT] = {
+  [OUTPUT_SERIAL]    = "serial",
+  [OUTPUT_BLUETOOTH] = "bluetooth",
+  [OUTPUT_UDP_NMEA]  = "udp_nmea",
+  [OUTPUT_UDP_GDL90] = "udp_gdl90"
+};
+
+static const char * const Metric_Stage[LATENCY_COUNT] = {
+  [LATENCY_DECODE]  = "decode",
+  [LATENCY_TRAFFIC] = "traffic",
+  [LATENCY_EXPORT]  = "export",
+  [LATENCY_LOOP]    = "loop"
+};
+
+/* a counter, or a set of them told apart by one label */
+typedef struct metric_family_struct {
+  const char          *name;
+  const char          *help;
+  const char          *label;
+  const char * const  *label_value;
+  const uint32_t      *value;
+  uint8_t             count;
+  uint8_t             stride;   /* words from one value to the next */
+} metric_family_t;
+
+#define OUTPUT_STATS_STRIDE (sizeof(output_stats_t) / sizeof(uint32_t))
+
+static const metric_family_t Metric_Family[] = {
+  { "rx_packets_total", "Packets received",
+    NULL, NULL, &rx_packets_counter, 1, 1 },
+  { "tx_packets_total", "Packets transmitted",
+    NULL, NULL, &tx_packets_counter, 1, 1 },
+  { "rx_crc_errors_total", "Packets failing the CRC or FEC check",
+    "protocol", Metric_Protocol, Metrics.rx_crc_errors, METRICS_PROTOCOLS, 1 },
+  { "rx_decode_errors_total", "Packets refused by the protocol decoder",
+    "protocol", Metric_Protocol, Metrics.rx_decode_errors, METRICS_PROTOCOLS, 1 },
+  { "traffic_evictions_total", "Expired traffic entries taken over",
+    NULL, NULL, &Metrics.traffic_evictions, 1, 1 },
+  { "traffic_dropped_total", "Aircraft left out for want of an entry",
+    NULL, NULL, &Metrics.traffic_dropped, 1, 1 },
+  { "tx_airtime_microseconds_total", "Time on air of transmitted packets",
+    NULL, NULL, &Airtime_Stats.airtime_us, 1, 1 },
+  { "tx_deferred_total", "Packets held back by the duty cycle limit",
+    NULL, NULL, &Airtime_Stats.deferred, 1, 1 },
+  { "loop_overruns_total", "Main loop iterations over 100 ms",
+    NULL, NULL, &Metrics.loop_overruns, 1, 1 },
+  { "output_bytes_total", "Bytes handed over to an output",
+    "output", Metric_Output, &Output_Stats[0].bytes, OUTPUT_COUNT, OUTPUT_STATS_STRIDE },
+  { "output_writes_total", "Device writes of an output",
+    "output", Metric_Output, &Output_Stats[0].writes, OUTPUT_COUNT, OUTPUT_STATS_STRIDE },
+  { "relay_rx_total", "Frames queued for relay",
+    NULL, NULL, &Relay_Stats.rx, 1, 1 },
+  { "relay_tx_total", "Frames relayed",
+    NULL, NULL, &Relay_Stats.tx, 1, 1 },
+  { "relay_dropped_total", "Frames expired or overflowed in the relay queue",
+    NULL, NULL, &Relay_Stats.dropped, 1, 1 },
+};
+
+#define METRIC_FAMILIES (sizeof(Metric_Family) / sizeof(Metric_Family[0]))
+
+typedef struct metrics_writer_struct {
+  char    *buf;
+  size_t  size;
+  size_t  len;    /* of the whole output, including what did not fit */
+} metrics_writer_t;
+
+static void Metrics_Printf(metrics_writer_t *w, const char *fmt, ...)
+{
+  bool room = (w->len < w->size);
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(room ? w->buf + w->len : NULL, room ? w->size - w->len : 0,
+                fmt, ap);
+  va_end(ap);
+
+  if (n > 0) {
+    w->len += n;
+  }
+}
+
+/* not every printf() of the targets does 64 bits */
+static const char *Metrics_U64(char *s, uint64_t v)
+{
+  char *p = s + 20;
+
+  *p = 0;
+  do {
+    *--p = '0' + v % 10;
+    v /= 10;
+  } while (v);
+
+  return p;
+}
+
+/* Prometheus text exposition format */
+size_t Metrics_Text(char *buf, size_t size)
+{
+  metrics_writer_t w = { buf, size, 0 };
+  char u64[21];
+
+  for (size_t f = 0; f < METRIC_FAMILIES; f++) {
+    const metric_family_t *mf = &Metric_Family[f];
+
+    Metrics_Printf(&w, "# HELP softrf_%s %s\n# TYPE softrf_%s counter\n",
+                   mf->name, mf->help, mf->name);
+
+    for (uint8_t k = 0; k < mf->count; k++) {
+      unsigned long v = mf->value[k * mf->stride];
+
+      if (mf->label) {
+        Metrics_Printf(&w, "softrf_%s{%s=\"%s\"} %lu\n",
+                       mf->name, mf->label, mf->label_value[k], v);
+      } else {
+        Metrics_Printf(&w, "softrf_%s %lu\n", mf->name, v);
+      }
+    }
+  }
+
+  Metrics_Printf(&w, "# HELP softrf_latency_microseconds "
+                     "RF reception to decode, traffic and export; loop time\n"
+                     "# TYPE softrf_latency_microseconds histogram\n");
+
+  for (uint8_t s = 0; s < LATENCY_COUNT; s++) {
+    latency_hist_t *h = &Latency[s];
+    uint64_t cum = 0;
+
+    /* the totals: Prometheus counters must not go down */
+    for (uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+      cum += h->total_bucket[b];
+      Metrics_Printf(&w, "softrf_latency_microseconds_bucket"
+                         "{stage=\"%s\",le=\"%lu\"} %s\n",
+                     Metric_Stage[s], (unsigned long) LATENCY_MIN_US << b,
+                     Metrics_U64(u64, cum));
+    }
+    Metrics_Printf(&w, "softrf_latency_microseconds_bucket"
+                       "{stage=\"%s\",le=\"+Inf\"} %s\n",
+                   Metric_Stage[s], Metrics_U64(u64, h->total));
+    Metrics_Printf(&w, "softrf_latency_microseconds_sum{stage=\"%s\"} %s\n",
+                   Metric_Stage[s], Metrics_U64(u64, h->sum_us));
+    Metrics_Printf(&w, "softrf_latency_microseconds_count{stage=\"%s\"} %s\n",
+                   Metric_Stage[s], Metrics_U64(u64, h->total));
+  }
+
+  return w.len;
+}
+
+size_t Metrics_JSON(char *buf, size_t size)
+{
+  metrics_writer_t w = { buf, size, 0 };
+  char u64[21];
+
+  Metrics_Printf(&w, "{");
+
+  for (size_t f = 0; f < METRIC_FAMILIES; f++) {
+    const metric_family_t *mf = &Metric_Family[f];
+
+    if (mf->label) {
+      Metrics_Printf(&w, "\"%s\":{", mf->name);
+      for (uint8_t k = 0; k < mf->count; k++) {
+        Metrics_Printf(&w, "%s\"%s\":%lu", k ? "," : "", mf->label_value[k],
+                       (unsigned long) mf->value[k * mf->stride]);
+      }
+      Metrics_Printf(&w, "},");
+    } else {
+      Metrics_Printf(&w, "\"%s\":%lu,", mf->name, (unsigned long) mf->value[0]);
+    }
+  }
+
+  Metrics_Printf(&w, "\"latency_us\":{");
+  for (uint8_t s = 0; s < LATENCY_COUNT; s++) {
+    latency_hist_t *h = &Latency[s];
+
+    Metrics_Printf(&w, "%s\"%s\":{\"count\":%s,", s ? "," : "", Metric_Stage[s],
+                   Metrics_U64(u64, h->total));
+    Metrics_Printf(&w, "\"sum\":%s,\"max\":%lu,\"buckets\":[",
+                   Metrics_U64(u64, h->sum_us), (unsigned long) h->max_us);
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+      Metrics_Printf(&w, "%s%s", b ? "," : "", Metrics_U64(u64, h->total_bucket[b]));
+    }
+    Metrics_Printf(&w, "]}");
+  }
+  Metrics_Printf(&w, "}}\n");
+
+  return w.len;
+}
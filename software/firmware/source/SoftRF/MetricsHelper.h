@@ -0,0 +1,61 @@
+/*
+ * MetricsHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef METRICSHELPER_H
+#define METRICSHELPER_H
+
+#include "SoftRF.h"
+
+#include <protocol.h>
+
+/*
+ * Runtime counters for fleet monitoring. Each one is a word bumped by
+ * the main loop only, so it needs no lock; a scraper on another thread
+ * reads whole words. Metrics_Text() and Metrics_JSON() lay them out,
+ * together with the packet, output and relay counters kept elsewhere
+ * and the latency histograms of LatencyHelper. Like snprintf(), they
+ * return the length the whole output takes, so that a call with no buffer
+ * sizes one, and a result not below the size given tells of truncation.
+ */
+#define METRICS_PROTOCOLS       (RF_PROTOCOL_FANET + 1)
+#define METRICS_LOOP_OVERRUN_MS 100
+#define METRICS_SLACK           64    /* bytes, for counters growing meanwhile */
+
+#if defined(RASPBERRY_PI)
+#define METRICS_TCP_PORT        9108
+#define METRICS_TIMEOUT_S       2     /* for a scraper to send or take */
+#endif /* RASPBERRY_PI */
+
+typedef struct metrics_struct {
+  uint32_t rx_crc_errors[METRICS_PROTOCOLS];    /* CRC or FEC check failed */
+  uint32_t rx_decode_errors[METRICS_PROTOCOLS]; /* protocol_decode() refused */
+  uint32_t traffic_evictions; /* expired entries taken over */
+  uint32_t traffic_dropped;   /* no entry left for an aircraft */
+  uint32_t loop_overruns;     /* iterations over METRICS_LOOP_OVERRUN_MS */
+} metrics_t;
+
+#define METRIC_INC(m)             (Metrics.m++)
+#define METRIC_INC_PROTOCOL(m, p) \
+  do { if ((p) < METRICS_PROTOCOLS) Metrics.m[(p)]++; } while (0)
+
+size_t Metrics_Text(char *, size_t);
+size_t Metrics_JSON(char *, size_t);
+
+extern metrics_t Metrics;
+
+#endif /* METRICSHELPER_H */
@@ -25,6 +25,8 @@
 #include "WiFiHelper.h"
 #include "EEPROMHelper.h"
 #include "TrafficHelper.h"
+#include "OutputHelper.h"
+#include "LatencyHelper.h"
 
 #define ADDR_TO_HEX_STR(s, c) (s += ((c) < 0x10 ? "0" : "") + String((c), HEX))
 
@@ -55,6 +57,10 @@ const char *NMEA_CallSign_Prefix[] = {
 #define isTimeToPGRMZ() (millis() - PGRMZ_TimeMarker > 1000)
 unsigned long PGRMZ_TimeMarker = 0;
 
+#define isTimeToNMEAExport() (millis() - NMEA_ExportTimeMarker >= \
+                              EXPORT_INTERVAL_MS(settings->nmea_rate))
+static unsigned long NMEA_ExportTimeMarker = 0;
+
 #if defined(ENABLE_AHRS)
 #include "AHRSHelper.h"
 
@@ -115,7 +121,7 @@ void NMEA_loop()
   if (settings->nmea_s && ThisAircraft.pressure_altitude != 0.0 && isTimeToPGRMZ()) {
 
     int altitude = constrain(
-            (int) (ThisAircraft.pressure_altitude * _GPS_FEET_PER_METER),
+            m_to_ft(ThisAircraft.pressure_altitude),
             -1000, 60000);
 
     snprintf_P(NMEABuffer, sizeof(NMEABuffer), PSTR("$PGRMZ,%d,f,3*"),
@@ -193,28 +199,25 @@ void NMEA_fini()
 
 void NMEA_Out(byte *buf, size_t size, bool nl)
 {
+  /* a sentence and its line end go out as one chunk */
+  if (nl) {
+    if (size >= sizeof(UDPpacketBuffer))
+      size = sizeof(UDPpacketBuffer) - 1;
+    memmove(UDPpacketBuffer, buf, size);
+    UDPpacketBuffer[size++] = '\n';
+    buf = (byte *) UDPpacketBuffer;
+  }
+
   switch(settings->nmea_out)
   {
   case NMEA_UART:
     {
-      Serial.write(buf, size);
-      if (nl)
-        Serial.write('\n');
+      Output_Write(OUTPUT_SERIAL, buf, size);
     }
     break;
   case NMEA_UDP:
     {
-      size_t udp_size = size;
-
-      if (size >= sizeof(UDPpacketBuffer))
-        udp_size = sizeof(UDPpacketBuffer) - 1;
-      memcpy(UDPpacketBuffer, buf, udp_size);
-
-      if (nl)
-        UDPpacketBuffer[udp_size] = '\n';
-
-      SoC->WiFi_transmit_UDP(NMEA_UDP_PORT, (byte *) UDPpacketBuffer,
-                              nl ? udp_size + 1 : udp_size);
+      Output_Write(OUTPUT_UDP_NMEA, buf, size);
     }
     break;
   case NMEA_TCP:
@@ -224,8 +227,6 @@ void NMEA_Out(byte *buf, size_t size, bool nl)
         if (NmeaTCP[acc_ndx].client && NmeaTCP[acc_ndx].client.connected()){
           if (NmeaTCP[acc_ndx].ack) {
             NmeaTCP[acc_ndx].client.write(buf, size);
-            if (nl)
-              NmeaTCP[acc_ndx].client.write('\n');
           }
         }
       }
@@ -234,11 +235,7 @@ void NMEA_Out(byte *buf, size_t size, bool nl)
     break;
   case NMEA_BLUETOOTH:
     {
-      if (SoC->Bluetooth) {
-        SoC->Bluetooth->write(buf, size);
-        if (nl)
-          SoC->Bluetooth->write((byte *) "\n", 1);
-      }
+      Output_Write(OUTPUT_BLUETOOTH, buf, size);
     }
     break;
   case NMEA_OFF:
@@ -262,6 +259,12 @@ void NMEA_Export()
     int HP_alt_diff = 0;
     int HP_alarm_level = ALARM_LEVEL_NONE;
     float HP_distance = 2147483647;
+    bool HP_found = false;
+
+    if (!isTimeToNMEAExport()) {
+      return;
+    }
+    NMEA_ExportTimeMarker = millis();
 
     /* account for all detected objects at first */
     for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
@@ -270,7 +273,10 @@ void NMEA_Export()
       }
     }
 
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    /* most relevant objects go first */
+    for (int r=0; r < Traffic_Ranked; r++) {
+      int i = Traffic_Ranking[r];
+
       if (Container[i].addr && (this_moment - Container[i].timestamp) <= EXPORT_EXPIRATION_TIME) {
 
 #if 0
@@ -298,9 +304,10 @@ void NMEA_Export()
             alt_diff = (int) (Container[i].altitude - ThisAircraft.altitude);
 
             if (!Container[i].stealth && !ThisAircraft.stealth) {
-              dtostrf(
-                constrain(Container[i].vs / (_GPS_FEET_PER_METER * 60.0), -32.7, 32.7),
-                5, 1, str_climb_rate);
+              int climb = constrain(fpm_to_cms(Container[i].vs) / 10, -327, 327); /* dm/s */
+
+              snprintf(str_climb_rate, sizeof(str_climb_rate), "%s%d.%d",
+                       climb < 0 ? "-" : "", abs(climb) / 10, abs(climb) % 10);
             }
 
             /*
@@ -331,19 +338,39 @@ void NMEA_Export()
                     alarm_level,
                     (int) (distance * cos(radians(bearing))), (int) (distance * sin(radians(bearing))),
                     alt_diff, addr_type, Container[i].addr, NMEA_Callsign,
-                    (int) Container[i].course, (int) (Container[i].speed * _GPS_MPS_PER_KNOT),
+                    (int) Container[i].course, (int) (knots_to_cms(Container[i].speed) / 100),
                     ltrim(str_climb_rate), Container[i].aircraft_type);
 
             NMEA_add_checksum(NMEABuffer, sizeof(NMEABuffer) - strlen(NMEABuffer));
 
-            NMEA_Out((byte *) NMEABuffer, strlen(NMEABuffer), false);
+            if (Traffic_NeedsExport(i, EXPORT_SINK_NMEA)) {
+              NMEA_Out((byte *) NMEABuffer, strlen(NMEABuffer), false);
+              Latency_Export(&Container[i]);
+
+              /* which protocol provided which field of a fused track */
+              if (settings->nmea_p && Traffic_Fusion[i].fused) {
+                traffic_fusion_t *tf = &Traffic_Fusion[i];
+
+                StdOut.print(F("$PSRFF,"));
+                StdOut.print(Container[i].addr, HEX); StdOut.print(F(","));
+                StdOut.print(tf->alias, HEX);         StdOut.print(F(","));
+                StdOut.print(NMEA_CallSign_Prefix[tf->source[TRAFFIC_FIELD_POSITION]]);
+                StdOut.print(F(","));
+                StdOut.print(NMEA_CallSign_Prefix[tf->source[TRAFFIC_FIELD_ALTITUDE]]);
+                StdOut.print(F(","));
+                StdOut.print(NMEA_CallSign_Prefix[tf->source[TRAFFIC_FIELD_BARO]]);
+                StdOut.print(F(","));
+                StdOut.println(NMEA_CallSign_Prefix[tf->source[TRAFFIC_FIELD_CLIMB]]);
+              }
+            }
 
-            /* Most close traffic is treated as highest priority target */
-            if (distance < HP_distance) {
+            /* Top ranked traffic is treated as highest priority target */
+            if (!HP_found) {
               HP_bearing = bearing;
               HP_alt_diff = alt_diff;
               HP_alarm_level = alarm_level;
               HP_distance = distance;
+              HP_found = true;
             }
 
           }
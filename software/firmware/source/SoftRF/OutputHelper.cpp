@@ -0,0 +1,141 @@
+/*
+ * OutputHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoCHelper.h"
+#include "OutputHelper.h"
+
+static byte Serial_Buf[OUTPUT_SERIAL_BUFSIZE];
+static byte BT_Buf[OUTPUT_BT_BUFSIZE];
+static byte UDP_NMEA_Buf[OUTPUT_UDP_BUFSIZE];
+static byte UDP_GDL90_Buf[OUTPUT_UDP_BUFSIZE];
+
+typedef struct output_buffer_struct {
+  byte          *buf;
+  size_t        size;
+  size_t        len;
+  unsigned long first_ms;  /* when the oldest pending byte was buffered */
+} output_buffer_t;
+
+static output_buffer_t Output_Buffer[OUTPUT_COUNT] = {
+  { Serial_Buf,    sizeof(Serial_Buf),    0, 0 },
+  { BT_Buf,        sizeof(BT_Buf),        0, 0 },
+  { UDP_NMEA_Buf,  sizeof(UDP_NMEA_Buf),  0, 0 },
+  { UDP_GDL90_Buf, sizeof(UDP_GDL90_Buf), 0, 0 },
+};
+
+output_stats_t Output_Stats[OUTPUT_COUNT];
+
+#if defined(RASPBERRY_PI)
+FILE *Output_Capture[OUTPUT_COUNT];
+#endif /* RASPBERRY_PI */
+
+static void Output_Device(uint8_t dest, const byte *buf, size_t size)
+{
+#if defined(RASPBERRY_PI)
+  if (Output_Capture[dest]) {
+    fwrite(buf, 1, size, Output_Capture[dest]);
+    Output_Stats[dest].bytes += size;
+    Output_Stats[dest].writes++;
+    return;
+  }
+#endif /* RASPBERRY_PI */
+
+  switch (dest)
+  {
+  case OUTPUT_SERIAL:
+    Serial.write((byte *) buf, size);
+    break;
+  case OUTPUT_BLUETOOTH:
+    if (SoC->Bluetooth) {
+      SoC->Bluetooth->write(buf, size);
+    }
+    break;
+  case OUTPUT_UDP_NMEA:
+    SoC->WiFi_transmit_UDP(NMEA_UDP_PORT, (byte *) buf, size);
+    break;
+  case OUTPUT_UDP_GDL90:
+    SoC->WiFi_transmit_UDP(GDL90_DST_PORT, (byte *) buf, size);
+    break;
+  default:
+    return;
+  }
+
+  Output_Stats[dest].bytes += size;
+  Output_Stats[dest].writes++;
+}
+
+void Output_Flush(uint8_t dest)
+{
+  output_buffer_t *ob = &Output_Buffer[dest];
+
+  if (ob->len > 0) {
+    uint32_t latency = millis() - ob->first_ms;
+
+    Output_Device(dest, ob->buf, ob->len);
+    ob->len = 0;
+
+    if (latency > Output_Stats[dest].latency_max) {
+      Output_Stats[dest].latency_max = latency;
+    }
+    Output_Stats[dest].latency_sum += latency;
+  }
+}
+
+void Output_Write(uint8_t dest, const byte *buf, size_t size)
+{
+  if (dest >= OUTPUT_COUNT || size == 0) {
+    return;
+  }
+
+  output_buffer_t *ob = &Output_Buffer[dest];
+
+  Output_Stats[dest].chunks++;
+
+  /* UDP datagrams must carry whole sentences, so never split a chunk */
+  if (ob->len + size > ob->size) {
+    Output_Flush(dest);
+  }
+
+  if (size > ob->size) {
+    Output_Device(dest, buf, size);
+    return;
+  }
+
+  if (ob->len == 0) {
+    ob->first_ms = millis();
+  }
+  memcpy(ob->buf + ob->len, buf, size);
+  ob->len += size;
+}
+
+void Output_loop()
+{
+  for (uint8_t dest = 0; dest < OUTPUT_COUNT; dest++) {
+    if (Output_Buffer[dest].len > 0 &&
+        millis() - Output_Buffer[dest].first_ms >= OUTPUT_FLUSH_DEADLINE_MS) {
+      Output_Flush(dest);
+    }
+  }
+}
+
+void Output_fini()
+{
+  for (uint8_t dest = 0; dest < OUTPUT_COUNT; dest++) {
+    Output_Flush(dest);
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * OutputHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUTHELPER_H
+#define OUTPUTHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Per-destination coalescing buffers for NMEA, GDL90 and Dump1090 output.
+ * A buffer is flushed when the next chunk does not fit into it
+ * or when its oldest byte is older than OUTPUT_FLUSH_DEADLINE_MS.
+ */
+enum
+{
+  OUTPUT_SERIAL,
+  OUTPUT_BLUETOOTH,
+  OUTPUT_UDP_NMEA,
+  OUTPUT_UDP_GDL90,
+  OUTPUT_COUNT
+};
+
+#if defined(RASPBERRY_PI)
+#define OUTPUT_SERIAL_BUFSIZE   4096  /* pipe or pty */
+#define OUTPUT_UDP_BUFSIZE      1472  /* Ethernet MTU less IP/UDP headers */
+#else
+#define OUTPUT_SERIAL_BUFSIZE   128   /* UART TX FIFO */
+#define OUTPUT_UDP_BUFSIZE      512
+#endif /* RASPBERRY_PI */
+#define OUTPUT_BT_BUFSIZE       128
+
+#define OUTPUT_FLUSH_DEADLINE_MS  20
+
+typedef struct output_stats_struct {
+  uint32_t bytes;         /* payload bytes handed over to the device */
+  uint32_t chunks;        /* Output_Write() calls */
+  uint32_t writes;        /* device write calls */
+  uint32_t latency_max;   /* ms from first buffered byte to flush */
+  uint32_t latency_sum;   /* ms, average is latency_sum / writes */
+} output_stats_t;
+
+void Output_Write(uint8_t, const byte *, size_t);
+void Output_Flush(uint8_t);
+void Output_loop(void);
+void Output_fini(void);
+
+extern output_stats_t Output_Stats[OUTPUT_COUNT];
+
+#if defined(RASPBERRY_PI)
+/* replays write every destination into a file of its own instead */
+extern FILE *Output_Capture[OUTPUT_COUNT];
+#endif /* RASPBERRY_PI */
+
+#endif /* OUTPUTHELPER_H */
@@ -61,13 +61,29 @@
 #include "WiFiHelper.h"
 #include "EPDHelper.h"
 #include "BatteryHelper.h"
+#include "OutputHelper.h"
+#include "RelayHelper.h"
+#include "TrackHelper.h"
+#include "GeneratorHelper.h"
+#include "BenchHelper.h"
+#include "LatencyHelper.h"
+#include "MetricsHelper.h"
 
 #include "TCPServer.h"
 
 #include <stdio.h>
+#include <signal.h>
 #include <sys/select.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <getopt.h>
+#include <time.h>
 
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <deque>
 
 #include <ArduinoJson.h>
 
@@ -115,6 +131,73 @@ std::string input_line;
 
 TCPServer Traffic_TCP_Server;
 
+static bool Replay = false;  /* input comes from a log, on simulated clock */
+
+/* own-ship id on replays, so that outputs do not depend on the host */
+#define REPLAY_ADDR       0x5EF000
+
+static uint64_t RPi_Wall_us()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#if DEBUG_TIMING
+/*
+ * Main loop period and GNSS fix-to-use latency, in wall time.
+ * A replay feeds its GNSS lines to standard input through a pipe, so that
+ * they take the same path as live ones, and latency is counted from the
+ * write of the line that completed the fix. Live input has no such time,
+ * so only replays report latency; run them at real speed, -s 1.
+ */
+typedef struct timing_stats_struct {
+  unsigned long n;
+  double        sum;      /* us */
+  double        sum2;
+  uint64_t      max;
+} timing_stats_t;
+
+static timing_stats_t        Loop_Period;
+static timing_stats_t        GNSS_Latency;
+static std::atomic<uint64_t> GNSS_Sent_us(0);  /* replays only */
+static int                   Replay_GNSS_fd = -1;
+
+static void RPi_Timing_Add(timing_stats_t *ts, uint64_t us)
+{
+  ts->n++;
+  ts->sum  += us;
+  ts->sum2 += (double) us * us;
+  if (us > ts->max) {
+    ts->max = us;
+  }
+}
+
+/* mean, standard deviation (jitter) and worst case */
+static void RPi_Timing_Print(const char *name, timing_stats_t *ts)
+{
+  if (ts->n > 0) {
+    double mean = ts->sum / ts->n;
+    double var  = ts->sum2 / ts->n - mean * mean;
+
+    fprintf( stderr, "%s: %lu, mean %.0f us, jitter %.0f us, max %llu us\n",
+             name, ts->n, mean, var > 0 ? sqrt(var) : 0.0,
+             (unsigned long long) ts->max );
+  }
+  memset(ts, 0, sizeof(*ts));
+}
+
+static void RPi_Fix_Used()
+{
+  uint64_t sent_us = GNSS_Sent_us.load(std::memory_order_relaxed);
+
+  if (sent_us) {
+    RPi_Timing_Add(&GNSS_Latency, RPi_Wall_us() - sent_us);
+  }
+}
+#endif
+
 static void RPi_setup()
 {
   eeprom_block.field.magic = SOFTRF_EEPROM_MAGIC;
@@ -140,6 +223,14 @@ static void RPi_setup()
   eeprom_block.field.settings.stealth    = false;
   eeprom_block.field.settings.no_track   = false;
   eeprom_block.field.settings.power_save = POWER_SAVE_NONE;
+
+  eeprom_block.field.settings.nmea_rate    = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.gdl90_rate   = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.d1090_rate   = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.json_rate    = EXPORT_RATE_1HZ;
+  eeprom_block.field.settings.export_delta = false;
+  eeprom_block.field.settings.json_out     = JSON_OUT_STDOUT;
+  eeprom_block.field.settings.gnss_pvt     = false;
 }
 
 static void RPi_fini()
@@ -157,9 +248,29 @@ static long RPi_random(long howsmall, long howBig)
   return random(howsmall, howBig);
 }
 
+static int RPi_UDP_socket = -1;
+
 static void RPi_WiFi_transmit_UDP(int port, byte *buf, size_t size)
 {
-  /* TBD */
+  struct sockaddr_in dst;
+
+  if (RPi_UDP_socket < 0) {
+    int broadcast = 1;
+
+    RPi_UDP_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (RPi_UDP_socket < 0) {
+      return;
+    }
+    setsockopt(RPi_UDP_socket, SOL_SOCKET, SO_BROADCAST,
+               &broadcast, sizeof(broadcast));
+  }
+
+  memset(&dst, 0, sizeof(dst));
+  dst.sin_family      = AF_INET;
+  dst.sin_port        = htons(port);
+  dst.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+  sendto(RPi_UDP_socket, buf, size, 0, (struct sockaddr *) &dst, sizeof(dst));
 }
 
 static void RPi_SPI_begin()
@@ -275,6 +386,7 @@ const SoC_ops_t RPi_ops = {
   RPi_WDT_fini
 };
 
+#if !defined(USE_GNSS_THREAD)
 static bool inputAvailable()
 {
   struct timeval tv;
@@ -299,7 +411,10 @@ static void parseNMEA(const char *str, int len)
 
   GNSSTimeSync();
 
-  if (isValidGNSSFix()) {
+  if (isValidNMEAFix()) {
+#if DEBUG_TIMING
+    RPi_Fix_Used();
+#endif
     ThisAircraft.latitude = gnss.location.lat();
     ThisAircraft.longitude = gnss.location.lng();
     ThisAircraft.altitude = gnss.altitude.meters();
@@ -321,57 +436,310 @@ static void parseNMEA(const char *str, int len)
     }
   }
 }
+#endif /* USE_GNSS_THREAD */
 
-static void RPi_PickGNSSFix()
+/* the radio is not probed on replays, only its protocol codec is set */
+static void RPi_Replay_Protocol()
 {
-  if (inputAvailable()) {
-    std::getline(std::cin, input_line);
-    const char *str = input_line.c_str();
-    int len = input_line.length();
+  switch (settings->rf_protocol)
+  {
+  case RF_PROTOCOL_OGNTP:
+    protocol_encode = &ogntp_encode;
+    protocol_decode = &ogntp_decode;
+    break;
+  case RF_PROTOCOL_P3I:
+    protocol_encode = &p3i_encode;
+    protocol_decode = &p3i_decode;
+    break;
+  case RF_PROTOCOL_FANET:
+    protocol_encode = &fanet_encode;
+    protocol_decode = &fanet_decode;
+    break;
+  case RF_PROTOCOL_ADSB_UAT:
+    protocol_encode = &uat978_encode;
+    protocol_decode = &uat978_decode;
+    break;
+  case RF_PROTOCOL_LEGACY:
+  default:
+    protocol_encode = &legacy_encode;
+    protocol_decode = &legacy_decode;
+    break;
+  }
+}
 
-    if (str[0] == '$' && str[1] == 'G') {
-      // NMEA input
-      parseNMEA(str, len);
+static void RPi_ParseInput(const char *str, int len)
+{
+  if (str[0] == '$' && str[1] == 'G') {
+#if defined(USE_GNSS_THREAD)
+    /* the reader thread has parsed it already, pass it through only */
+    NMEA_Out((byte *) str, len, true);
+#else
+    // NMEA input
+    parseNMEA(str, len);
+#endif /* USE_GNSS_THREAD */
 
-    } else if (str[0] == '{') {
-      // JSON input
+  } else if (str[0] == '{') {
+    // JSON input
 
-      JsonObject& root = jsonBuffer.parseObject(str);
+    JsonObject& root = jsonBuffer.parseObject(str);
 
-      JsonVariant msg_class = root["class"];
+    JsonVariant msg_class = root["class"];
 
-      if (msg_class.success()) {
-        const char *msg_class_s = msg_class.as<char*>();
+    if (msg_class.success()) {
+      const char *msg_class_s = msg_class.as<char*>();
 
-        if (!strcmp(msg_class_s,"TPV")) { // "TPV"
-          parseTPV(root);
-        } else if (!strcmp(msg_class_s,"SOFTRF")) {
-          parseSettings(root);
+      if (!strcmp(msg_class_s,"TPV")) { // "TPV"
+        parseTPV(root);
+      } else if (!strcmp(msg_class_s,"SOFTRF")) {
+        parseSettings(root);
 
+        if (Replay) {
+          RPi_Replay_Protocol();
+        } else {
           RF_setup();
-          Traffic_setup();
         }
+        Traffic_setup();
       }
+    }
 
-      if (root.containsKey("now") &&
-          root.containsKey("messages") &&
-          root.containsKey("aircraft")) {
-        /* 'aircraft.json' output from 'dump1090' application */
-        parseD1090(root);
-      } else if (root.containsKey("aircraft")) {
-        /* uAvionix PingStation */
-        parsePING(root);
-      }
+    if (root.containsKey("now") &&
+        root.containsKey("messages") &&
+        root.containsKey("aircraft")) {
+      /* 'aircraft.json' output from 'dump1090' application */
+      parseD1090(root);
+    } else if (root.containsKey("aircraft")) {
+      /* uAvionix PingStation */
+      parsePING(root);
+    }
 
-      jsonBuffer.clear();
+    jsonBuffer.clear();
+
+    if ((time(NULL) - now()) > 3) {
+      hasValidGPSDFix = false;
+    }
+  }
+}
+
+#if defined(USE_GNSS_THREAD)
+
+/*
+ * Standard input is read in bulk and parsed by a thread of its own,
+ * so that the main loop never waits for it. Completed fixes are published
+ * through a double buffered seqlock, stamped with the time the sentence
+ * completing them arrived. Any other line is queued for the main loop.
+ *
+ * GNSS_Fix_Seq is odd while the writer fills GNSS_Fix[(seq / 2 + 1) & 1],
+ * the slot not being read. Readers take GNSS_Fix[(seq / 2) & 1], the latest
+ * complete one, and retry only when the writer has come back to that very
+ * slot meanwhile, i.e. when the sequence has moved by more than two.
+ */
+typedef struct gnss_fix_struct {
+  unsigned long ms;
+  float         latitude;
+  float         longitude;
+  float         altitude;
+  float         course;
+  float         speed;
+  float         geoid_separation;
+  uint16_t      hdop;
+  uint16_t      year;
+  uint8_t       month;
+  uint8_t       day;
+  uint8_t       hour;
+  uint8_t       minute;
+  uint8_t       second;
+  uint8_t       sats;
+} gnss_fix_t;
+
+static gnss_fix_t               GNSS_Fix[2];
+static std::atomic<uint32_t>    GNSS_Fix_Seq(0);
+static uint32_t                 GNSS_Fix_Used = 0;
+static std::mutex               GNSS_Lines_Mutex;
+static std::deque<std::string>  GNSS_Lines;
+
+static TinyGPSPlus gnss_rd;  /* owned by the reader thread */
+
+static unsigned long GNSS_TimeSyncMarker = 0;
+
+static void GNSS_Fix_Publish(const gnss_fix_t *fix)
+{
+  uint32_t seq = GNSS_Fix_Seq.load(std::memory_order_relaxed);
+
+  GNSS_Fix_Seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  GNSS_Fix[(seq / 2 + 1) & 1] = *fix;
+  GNSS_Fix_Seq.store(seq + 2, std::memory_order_release);
+}
+
+/* returns the (even) sequence of the fix taken */
+static uint32_t GNSS_Fix_Read(gnss_fix_t *fix)
+{
+  uint32_t seq;
+
+  do {
+    seq = GNSS_Fix_Seq.load(std::memory_order_acquire) & ~1U;
+    *fix = GNSS_Fix[(seq / 2) & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (GNSS_Fix_Seq.load(std::memory_order_relaxed) - seq > 2);
+
+  return seq;
+}
+
+static void GNSS_Reader_Line(const std::string &line)
+{
+  if (line.length() > 1 && line[0] == '$' && line[1] == 'G') {
+    bool complete = false;
+
+    for (size_t i = 0; i < line.length(); i++) {
+      complete |= gnss_rd.encode(line[i]);
+    }
+    complete |= gnss_rd.encode('\r');
+    complete |= gnss_rd.encode('\n');
+
+    if (complete && gnss_rd.location.isUpdated()   &&
+        gnss_rd.location.isValid()                 &&
+        gnss_rd.altitude.isValid()                 &&
+        gnss_rd.date.isValid()                     &&
+        gnss_rd.altitude.age() <= NMEA_EXP_TIME    &&
+        gnss_rd.date.age()     <= NMEA_EXP_TIME) {
+      gnss_fix_t fix;
+
+      fix.ms               = millis();
+      fix.latitude         = gnss_rd.location.lat();
+      fix.longitude        = gnss_rd.location.lng();
+      fix.altitude         = gnss_rd.altitude.meters();
+      fix.course           = gnss_rd.course.deg();
+      fix.speed            = gnss_rd.speed.knots();
+      fix.geoid_separation = gnss_rd.separation.meters();
+      fix.hdop             = (uint16_t) gnss_rd.hdop.value();
+      fix.year             = gnss_rd.date.year();
+      fix.month            = gnss_rd.date.month();
+      fix.day              = gnss_rd.date.day();
+      fix.hour             = gnss_rd.time.hour();
+      fix.minute           = gnss_rd.time.minute();
+      fix.second           = gnss_rd.time.second();
+      fix.sats             = gnss_rd.satellites.value();
+
+      GNSS_Fix_Publish(&fix);
+    }
+
+    if (!settings->nmea_g) {
+      return;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(GNSS_Lines_Mutex);
+  if (GNSS_Lines.size() < GNSS_LINES_MAX) {
+    GNSS_Lines.push_back(line);
+  }
+}
+
+void * gnss_reader_loop(void * m)
+{
+  char buf[GNSS_READ_BUFSIZE];
+  std::string line;
+
+  pthread_detach(pthread_self());
+
+  while (true) {
+    ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
 
-      if ((time(NULL) - now()) > 3) {
-        hasValidGPSDFix = false;
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+
+    for (ssize_t i = 0; i < n; i++) {
+      if (buf[i] == '\n') {
+        GNSS_Reader_Line(line);
+        line.clear();
+      } else if (buf[i] != '\r') {
+        line += buf[i];
       }
     }
   }
+
+  return NULL;
+}
+
+static void RPi_PickGNSSFix()
+{
+  gnss_fix_t fix;
+  uint32_t seq = GNSS_Fix_Read(&fix);
+
+  if (seq != GNSS_Fix_Used) {
+    GNSS_Fix_Used = seq;
+
+    GNSS_Decoded.source = GNSS_DECODED_READER;
+    GNSS_Decoded.valid  = true;
+    GNSS_Decoded.ms     = fix.ms;
+    GNSS_Decoded.year   = fix.year;
+    GNSS_Decoded.month  = fix.month;
+    GNSS_Decoded.day    = fix.day;
+    GNSS_Decoded.hour   = fix.hour;
+    GNSS_Decoded.minute = fix.minute;
+    GNSS_Decoded.second = fix.second;
+    GNSS_Decoded.sats   = fix.sats;
+
+    if (GNSS_TimeSyncMarker == 0 || millis() - GNSS_TimeSyncMarker > 60000) {
+      setTime(fix.hour, fix.minute, fix.second, fix.day, fix.month, fix.year);
+      GNSS_TimeSyncMarker = millis();
+    }
+
+    ThisAircraft.latitude = fix.latitude;
+    ThisAircraft.longitude = fix.longitude;
+    ThisAircraft.altitude = fix.altitude;
+    ThisAircraft.course = fix.course;
+    ThisAircraft.speed = fix.speed;
+    ThisAircraft.hdop = fix.hdop;
+    ThisAircraft.geoid_separation = fix.geoid_separation;
+
+    /*
+     * When geoidal separation is zero or not available - use approx. EGM96 value
+     */
+    if (ThisAircraft.geoid_separation == 0.0) {
+      ThisAircraft.geoid_separation = (float) LookupSeparation(
+                                                ThisAircraft.latitude,
+                                                ThisAircraft.longitude
+                                              );
+      /* we can assume the GPS unit is giving ellipsoid height */
+      ThisAircraft.altitude -= ThisAircraft.geoid_separation;
+    }
+
+#if DEBUG_TIMING
+    RPi_Fix_Used();
+#endif
+  }
+
+  std::deque<std::string> lines;
+  {
+    std::lock_guard<std::mutex> lock(GNSS_Lines_Mutex);
+    lines.swap(GNSS_Lines);
+  }
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    RPi_ParseInput(lines[i].c_str(), lines[i].length());
+  }
 }
 
+#else
+
+static void RPi_PickGNSSFix()
+{
+#if DEBUG_TIMING
+  if ((!Replay || Replay_GNSS_fd >= 0) && inputAvailable()) {
+#else
+  if (!Replay && inputAvailable()) {
+#endif
+    std::getline(std::cin, input_line);
+    RPi_ParseInput(input_line.c_str(), input_line.length());
+  }
+}
+
+#endif /* USE_GNSS_THREAD */
+
 static void RPi_ReadTraffic()
 {
   string traffic_input = Traffic_TCP_Server.getMessage();
@@ -421,6 +789,7 @@ static void RPi_ReadTraffic()
       jsonBuffer.clear();
     } else if (str[0] == 'q') {
       if (len >= 4 && str[1] == 'u' && str[2] == 'i' && str[3] == 't') {
+        Output_fini();
         Traffic_TCP_Server.detach();
         fprintf( stderr, "Program termination.\n" );
         exit(EXIT_SUCCESS);
@@ -431,8 +800,74 @@ static void RPi_ReadTraffic()
   }
 }
 
+#if DEBUG_TIMING
+static uint64_t Loop_Marker_us = 0;
+static unsigned long Loop_ReportMarker = 0;
+
+static void RPi_Timing_Report()
+{
+  RPi_Timing_Print("Loop period", &Loop_Period);
+  RPi_Timing_Print("GNSS fix latency", &GNSS_Latency);
+}
+
+/* main loop period and GNSS fix latency, reported once a minute */
+static void RPi_Loop_Timing()
+{
+  uint64_t us = RPi_Wall_us();
+
+  if (Loop_Marker_us) {
+    RPi_Timing_Add(&Loop_Period, us - Loop_Marker_us);
+  }
+  Loop_Marker_us = us;
+
+  if (millis() - Loop_ReportMarker > 60000) {
+    RPi_Timing_Report();
+    Loop_ReportMarker = millis();
+  }
+}
+#endif
+
+/*
+ * Replays report the wall time spent in each stage of normal_loop()
+ */
+enum
+{
+  STAGE_INPUT,
+  STAGE_RADIO,
+  STAGE_TRAFFIC,
+  STAGE_EXPORT,
+  STAGE_OTHER,
+  STAGE_COUNT
+};
+
+static const char *Stage_Name[STAGE_COUNT] = {
+  [STAGE_INPUT]   = "input",
+  [STAGE_RADIO]   = "radio",
+  [STAGE_TRAFFIC] = "traffic",
+  [STAGE_EXPORT]  = "export",
+  [STAGE_OTHER]   = "other"
+};
+
+static uint64_t Stage_us[STAGE_COUNT];
+static uint64_t Stage_Marker_us = 0;
+
+static void RPi_Stage(int stage)
+{
+  if (Replay) {
+    uint64_t us = RPi_Wall_us();
+
+    Stage_us[stage] += us - Stage_Marker_us;
+    Stage_Marker_us = us;
+  }
+}
+
 void normal_loop()
 {
+#if DEBUG_TIMING
+    RPi_Loop_Timing();
+#endif
+    Latency_loop();
+
     /* Read GNSS data from standard input */
     RPi_PickGNSSFix();
 
@@ -441,11 +876,14 @@ void normal_loop()
 
     RPi_ReadTraffic();
 
+    RPi_Stage(STAGE_INPUT);
+
     RF_loop();
 
     ThisAircraft.timestamp = now();
 
     if (isValidFix()) {
+      Track_loop();
       RF_Transmit(RF_Encode(&ThisAircraft), true);
     }
 
@@ -453,24 +891,176 @@ void normal_loop()
 
     if (success && isValidFix()) ParseData();
 
+    RPi_Stage(STAGE_RADIO);
+
     if (isValidFix()) {
       Traffic_loop();
     }
 
-    if (isTimeToExport() && isValidFix()) {
+    RPi_Stage(STAGE_TRAFFIC);
+
+    /* each export sink keeps its own pace, as per settings */
+    if (isValidFix()) {
       NMEA_Export();
       GDL90_Export();
       D1090_Export();
       JSON_Export();
-      ExportTimeMarker = millis();
     }
 
+    RPi_Stage(STAGE_EXPORT);
+
     // Handle Air Connect
     NMEA_loop();
 
     SoC->Display_loop();
 
     ClearExpired();
+
+    RPi_Stage(STAGE_OTHER);
+}
+
+/*
+ * Replay of a log with one "<ms> <line>" record per line, 'ms' counted
+ * from the start of the log. A line is whatever standard input takes
+ * (NMEA, JSON traffic or settings), or a $PSRFI sentence as printed on
+ * receipt of a radio packet when NMEA private output is on.
+ * normal_loop() runs every REPLAY_STEP_MS of simulated time, 'speed'
+ * times faster than real time, or as fast as it can when it is zero.
+ */
+#define REPLAY_STEP_MS    10
+#define REPLAY_TAIL_MS    5000  /* let exports drain after the last record */
+
+static const char *Replay_Output[OUTPUT_COUNT] = {
+  [OUTPUT_SERIAL]    = "serial",
+  [OUTPUT_BLUETOOTH] = "bt",
+  [OUTPUT_UDP_NMEA]  = "nmea",
+  [OUTPUT_UDP_GDL90] = "gdl90"
+};
+
+static void RPi_Replay_Line(const char *str)
+{
+  int len = strlen(str);
+
+#if DEBUG_TIMING
+  if (Replay_GNSS_fd >= 0 && str[0] == '$' && str[1] == 'G') {
+    std::string line = std::string(str, len) + "\r\n";  /* as a receiver does */
+
+    GNSS_Sent_us.store(RPi_Wall_us(), std::memory_order_relaxed);
+    if (write(Replay_GNSS_fd, line.c_str(), line.length()) < 0) {
+      fprintf( stderr, "Unable to feed GNSS input: %s\n", strerror(errno) );
+    }
+    return;
+  }
+#endif
+
+  if (!strncmp(str, "$PSRFI,", 7)) {
+    const char *hex = strchr(str + 7, ',');
+    int rssi = 0;
+    size_t size = 0;
+
+    if (hex == NULL) {
+      return;
+    }
+    for (hex++; size < sizeof(RxBuffer) && isxdigit(hex[0]) && isxdigit(hex[1]);
+         hex += 2) {
+      sscanf(hex, "%2hhx", &RxBuffer[size++]);
+    }
+    if (*hex == ',') {
+      rssi = atoi(hex + 1);
+      hex = strchr(hex + 1, ',');
+    }
+    RF_last_rssi = rssi;
+    RF_last_errors = hex && *hex == ',' ? atoi(hex + 1) : 0;
+    RF_rx_us = micros();
+
+    /*
+     * Legacy keys roll over every 64 seconds, decode with the time of
+     * receipt as recorded, not the one of the last fix before it
+     */
+    time_t timestamp = strtoul(str + 7, NULL, 10);
+    if (timestamp) {
+      ThisAircraft.timestamp = timestamp;
+    }
+
+    if (isValidFix()) {
+      ParseData();
+    }
+#if defined(USE_GNSS_THREAD)
+  } else if (str[0] == '$' && str[1] == 'G') {
+    GNSS_Reader_Line(std::string(str, len));
+#endif /* USE_GNSS_THREAD */
+  } else {
+    RPi_ParseInput(str, len);
+  }
+}
+
+static void RPi_Replay_Step(unsigned long *sim_ms, float speed)
+{
+  *sim_ms += REPLAY_STEP_MS;
+  simulateClock(*sim_ms);
+
+  Stage_Marker_us = RPi_Wall_us();
+  normal_loop();
+  Output_loop();
+
+  if (speed > 0) {
+    usleep((useconds_t) (REPLAY_STEP_MS * 1000 / speed));
+  }
+}
+
+static void RPi_Replay(FILE *log, float speed)
+{
+  char line[JSON_BUFFER_SIZE];
+  unsigned long sim_ms = 0;
+  unsigned long records = 0;
+  uint64_t start_us = RPi_Wall_us();
+
+  simulateClock(sim_ms);
+
+  while (fgets(line, sizeof(line), log)) {
+    char *str;
+    unsigned long ms = strtoul(line, &str, 10);
+
+    if (str == line || *str != ' ') {
+      continue;
+    }
+    str++;
+    str[strcspn(str, "\r\n")] = 0;
+
+    while (sim_ms < ms) {
+      RPi_Replay_Step(&sim_ms, speed);
+    }
+
+    RPi_Replay_Line(str);
+    records++;
+  }
+
+  for (unsigned long tail = sim_ms + REPLAY_TAIL_MS; sim_ms < tail; ) {
+    RPi_Replay_Step(&sim_ms, speed);
+  }
+
+  Output_fini();
+
+  uint64_t wall_us = RPi_Wall_us() - start_us;
+
+  fprintf( stderr, "Replayed %lu records, %lu ms in %llu ms\n", records,
+           sim_ms, (unsigned long long) (wall_us / 1000) );
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    fprintf( stderr, "  %-8s %10llu us  %5.1f%%\n", Stage_Name[i],
+             (unsigned long long) Stage_us[i],
+             wall_us ? 100.0 * Stage_us[i] / wall_us : 0.0 );
+  }
+  for (int i = 0; i < OUTPUT_COUNT; i++) {
+    if (Output_Stats[i].chunks) {
+      fprintf( stderr, "  %-8s %10u chunks %6u writes %8u bytes\n",
+               Replay_Output[i], Output_Stats[i].chunks,
+               Output_Stats[i].writes, Output_Stats[i].bytes );
+    }
+  }
+
+#if DEBUG_TIMING
+  RPi_Timing_Report();
+#endif
 }
 
 void relay_loop()
@@ -485,64 +1075,37 @@ void relay_loop()
 
     RF_loop();
 
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      size_t size = RF_Payload_Size(settings->rf_protocol);
-      size = size > sizeof(Container[i].raw) ? sizeof(Container[i].raw) : size;
-      String str = Bin2Hex(Container[i].raw, size);
-      size_t str_len = str.length();
+    /* decoded traffic (dump1090, PingStation) is re-encoded once, on arrival */
+    int slots[MAX_TRACKING_OBJECTS];
+    int count = isValidFix() ?
+                Traffic_Query_Radius(ALARM_ZONE_NONE * 2, 0, slots, MAX_TRACKING_OBJECTS) : 0;
 
-      if (str_len > 0) {
-        // Raw data
-        char hexdata[2 * MAX_PKT_SIZE + 1];
+    for (int k=0; k < count; k++) {
+      int i = slots[k];
 
-        str.toCharArray(hexdata, sizeof(hexdata));
+      if (Container[i].addr &&
+          Container[i].latitude  != 0.0 &&
+          Container[i].longitude != 0.0 &&
+          Container[i].altitude  != 0.0) {
 
-        if (str_len > 2 * MAX_PKT_SIZE) {
-          str_len = 2 * MAX_PKT_SIZE;
-        }
-
-        for(int j = 0; j < str_len ; j+=2)
-        {
-          TxBuffer[j>>1] = getVal(hexdata[j+1]) + (getVal(hexdata[j]) << 4);
-        }
-
-        size_t tx_size = str_len / 2;
-
-        if (tx_size > 0) {
-          /* Follow duty cycle rule */
-          if (RF_Transmit(tx_size, true /* false */)) {
-#if 0
-            printf("%s\n", str.c_str());
-#endif
-            Container[i] = EmptyFO;
-          }
-        }
-      } else if (isValidFix() &&
-                 Container[i].addr &&
-                 Container[i].latitude  != 0.0 &&
-                 Container[i].longitude != 0.0 &&
-                 Container[i].altitude  != 0.0 &&
-                 Container[i].distance < (ALARM_ZONE_NONE * 2) ) {
+        byte buf[MAX_PKT_SIZE];
+        size_t size = 0;
 
         fo = Container[i];
         fo.timestamp = now(); /* GNSS date&time */
 
-        /* Follow duty cycle rule */
-        if (RF_Transmit(RF_Encode(&fo), true /* false */)) {
-#if 0
-          printf("%06X %f %f %f %d %d %d\n",
-              fo.addr,
-              fo.latitude,
-              fo.longitude,
-              fo.altitude,
-              fo.addr_type,
-              (int) fo.vs,
-              fo.aircraft_type);
-#endif
-          Container[i] = EmptyFO;
+        if (protocol_encode) {
+          size = (*protocol_encode)((void *) buf, &fo);
         }
+
+        Relay_Enqueue(buf, size, settings->rf_protocol, fo.addr, fo.rssi);
+
+        Traffic_Clear(i);
+        Traffic_Rank(i);
       }
     }
+
+    Relay_loop();
 }
 
 unsigned int pos_ndx = 0;
@@ -659,22 +1222,253 @@ void * traffic_tcpserv_loop(void * m)
   Traffic_TCP_Server.receive();
 }
 
-int main()
+/*
+ * Minimal HTTP/1.0 responder for scrapers: "/metrics.json" gets JSON,
+ * any other request Prometheus text. Counters are read as they are.
+ */
+void * metrics_serv_loop(void * m)
 {
-  // Init GPIO bcm
-  if (!bcm2835_init()) {
-      fprintf( stderr, "bcm2835_init() Failed\n\n" );
-      exit(EXIT_FAILURE);
+  struct sockaddr_in addr;
+  int reuse = 1;
+  int srv;
+
+  pthread_detach(pthread_self());
+
+  srv = socket(AF_INET, SOCK_STREAM, 0);
+  if (srv < 0) {
+    return NULL;
+  }
+  setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(METRICS_TCP_PORT);
+
+  if (bind(srv, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(srv, 4) < 0) {
+    fprintf( stderr, "Metrics server failed to listen on port %d\n", METRICS_TCP_PORT );
+    close(srv);
+    return NULL;
+  }
+
+  while (true) {
+    char request[256];
+    char header[128];
+    int fd = accept(srv, NULL, NULL);
+
+    if (fd < 0) {
+      continue;
+    }
+
+    /* a client that connects and stays silent must not hold the thread */
+    struct timeval tv = { METRICS_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+    request[n > 0 ? n : 0] = 0;
+
+    bool json = (strstr(request, "/metrics.json") != NULL);
+    size_t size = (json ? Metrics_JSON(NULL, 0) : Metrics_Text(NULL, 0)) +
+                  METRICS_SLACK;
+    char *body = (char *) malloc(size);
+
+    if (body == NULL) {
+      close(fd);
+      continue;
+    }
+
+    size_t len = json ? Metrics_JSON(body, size) : Metrics_Text(body, size);
+    if (len >= size) {
+      fprintf( stderr, "Metrics truncated to %u of %u bytes\n",
+               (unsigned int) (size - 1), (unsigned int) len );
+      len = size - 1;
+    }
+    int hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+                        "Content-Length: %u\r\n\r\n",
+                        json ? "application/json" : "text/plain; version=0.0.4",
+                        (unsigned int) len);
+
+    send(fd, header, hlen, MSG_NOSIGNAL);
+    send(fd, body, len, MSG_NOSIGNAL);
+    close(fd);
+    free(body);
+  }
+
+  return NULL;
+}
+
+static void RPi_Usage(const char *name)
+{
+  fprintf( stderr, "Usage: %s [-r log [-s speed] [-o prefix]]\n"
+                   "  -r log     replay a recorded log on simulated clock\n"
+                   "  -s speed   times real time, 0 is as fast as possible (1)\n"
+                   "  -o prefix  capture each output into <prefix>.<output>,\n"
+                   "             anything else on stdout into <prefix>.stdout\n"
+                   "   or: %s -g gliders[,airliners[,paragliders]] [-f format]\n"
+                   "          [-d dest] [-p lat,lon] [-R rate] [-t seconds]"
+                   " [-P protocol]\n"
+                   "          [-e encounter]\n"
+                   "  -g counts  generate synthetic traffic instead\n"
+                   "  -f format  log, raw, d1090 or gdl90 (log)\n"
+                   "  -d dest    -, udp:host:port or tcp:host:port (-)\n"
+                   "  -p lat,lon centre of the scene\n"
+                   "  -R rate    reports per second of each aircraft (1)\n"
+                   "  -t seconds run time, 0 is until interrupted (0)\n"
+                   "  -P name    legacy or ogntp, radio of the gliders (legacy)\n"
+                   "  -e name    head-on, crossing, overtake or pass, one scripted\n"
+                   "             target meeting own-ship, counts may be 0\n"
+                   "   or: %s -b name\n"
+                   "  -b name    run a benchmark, or all of them:\n",
+           name, name, name );
+  Bench_Usage(stderr);
+  exit(EXIT_FAILURE);
+}
+
+static volatile sig_atomic_t Generator_Stop = 0;
+
+static void RPi_Generator_Stop(int sig)
+{
+  (void) sig;
+  Generator_Stop = 1;
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *replay_log = NULL;
+  const char *capture = NULL;
+  float replay_speed = 1.0;
+  bool generate = false;
+  const char *bench = NULL;
+  generator_config_t gen = {
+    .gliders     = 0,
+    .airliners   = 0,
+    .paragliders = 0,
+    .latitude    = txrx_test_positions[0][0],
+    .longitude   = txrx_test_positions[0][1],
+    .protocol    = RF_PROTOCOL_LEGACY,
+    .format      = GENERATOR_FORMAT_LOG,
+    .encounter   = GENERATOR_ENCOUNTER_NONE,
+    .rate        = 1.0,
+    .duration_ms = 0,
+    .dest        = "-"
+  };
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:s:o:g:f:d:p:R:t:P:e:b:")) != -1) {
+    switch (opt)
+    {
+    case 'r':
+      replay_log = fopen(optarg, "r");
+      if (replay_log == NULL) {
+        fprintf( stderr, "Unable to open %s\n", optarg );
+        exit(EXIT_FAILURE);
+      }
+      Replay = true;
+      break;
+    case 's':
+      replay_speed = atof(optarg);
+      break;
+    case 'o':
+      capture = optarg;
+      break;
+    case 'g':
+      sscanf(optarg, "%u,%u,%u", &gen.gliders, &gen.airliners, &gen.paragliders);
+      generate = true;
+      break;
+    case 'f':
+      if      (!strcmp(optarg, "log"))   gen.format = GENERATOR_FORMAT_LOG;
+      else if (!strcmp(optarg, "raw"))   gen.format = GENERATOR_FORMAT_RAW;
+      else if (!strcmp(optarg, "d1090")) gen.format = GENERATOR_FORMAT_D1090;
+      else if (!strcmp(optarg, "gdl90")) gen.format = GENERATOR_FORMAT_GDL90;
+      else RPi_Usage(argv[0]);
+      break;
+    case 'd':
+      gen.dest = optarg;
+      break;
+    case 'p':
+      sscanf(optarg, "%f,%f", &gen.latitude, &gen.longitude);
+      break;
+    case 'R':
+      gen.rate = atof(optarg);
+      break;
+    case 't':
+      gen.duration_ms = strtoul(optarg, NULL, 10) * 1000;
+      break;
+    case 'P':
+      if      (!strcmp(optarg, "legacy")) gen.protocol = RF_PROTOCOL_LEGACY;
+      else if (!strcmp(optarg, "ogntp"))  gen.protocol = RF_PROTOCOL_OGNTP;
+      else RPi_Usage(argv[0]);
+      break;
+    case 'e':
+      if      (!strcmp(optarg, "head-on"))  gen.encounter = GENERATOR_ENCOUNTER_HEAD_ON;
+      else if (!strcmp(optarg, "crossing")) gen.encounter = GENERATOR_ENCOUNTER_CROSSING;
+      else if (!strcmp(optarg, "overtake")) gen.encounter = GENERATOR_ENCOUNTER_OVERTAKE;
+      else if (!strcmp(optarg, "pass"))     gen.encounter = GENERATOR_ENCOUNTER_PASS;
+      else RPi_Usage(argv[0]);
+      generate = true;
+      break;
+    case 'b':
+      bench = optarg;
+      break;
+    default:
+      RPi_Usage(argv[0]);
+    }
+  }
+
+  if (bench) {
+    hw_info.soc = SoC_setup();
+
+    if (!Bench_Run(bench)) {
+      RPi_Usage(argv[0]);
+    }
+
+    return 0;
   }
 
-  Serial.begin(38400);
+  if (generate) {
+    /* no radio, no GNSS, only encoders and a destination */
+    hw_info.soc = SoC_setup();
+
+    if (!Generator_setup(&gen)) {
+      RPi_Usage(argv[0]);
+    }
+
+    signal(SIGINT,  RPi_Generator_Stop);
+    signal(SIGTERM, RPi_Generator_Stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    while (!Generator_Stop && Generator_loop());
+    Generator_fini();
+
+    return 0;
+  }
+
+  if (Replay) {
+    /* no GPIO access, and the clock is driven by the log */
+    simulateClock(0);
+  } else {
+    // Init GPIO bcm
+    if (!bcm2835_init()) {
+        fprintf( stderr, "bcm2835_init() Failed\n\n" );
+        exit(EXIT_FAILURE);
+    }
+
+    Serial.begin(38400);
+  }
 
   hw_info.soc = SoC_setup(); // Has to be very first procedure in the execution order
 
-  hw_info.rf = RF_setup();
+  if (Replay) {
+    RPi_Replay_Protocol();
+  } else {
+    hw_info.rf = RF_setup();
 
-  if (hw_info.rf == RF_IC_NONE) {
-      exit(EXIT_FAILURE);
+    if (hw_info.rf == RF_IC_NONE) {
+        exit(EXIT_FAILURE);
+    }
   }
 
 #if 0
@@ -688,7 +1482,7 @@ int main()
   }
 #endif
 
-  ThisAircraft.addr = SoC->getChipId() & 0x00FFFFFF;
+  ThisAircraft.addr = Replay ? REPLAY_ADDR : SoC->getChipId() & 0x00FFFFFF;
   ThisAircraft.aircraft_type = settings->aircraft_type;
   ThisAircraft.protocol = settings->rf_protocol;
   ThisAircraft.stealth  = settings->stealth;
@@ -699,14 +1493,73 @@ int main()
   Traffic_setup();
   NMEA_setup();
 
+  if (Replay) {
+    for (int i = 0; capture && i < OUTPUT_COUNT; i++) {
+      std::string name = std::string(capture) + "." + Replay_Output[i];
+
+      Output_Capture[i] = fopen(name.c_str(), "wb");
+    }
+
+    /* $PSRFI, $PSRFF and the like are printed straight to stdout */
+    if (capture &&
+        freopen((std::string(capture) + ".stdout").c_str(), "w", stdout) == NULL) {
+      fprintf( stderr, "Unable to open %s.stdout\n", capture );
+      exit(EXIT_FAILURE);
+    }
+
+#if DEBUG_TIMING
+    int fds[2];
+
+    if (pipe(fds) == 0 && dup2(fds[0], STDIN_FILENO) >= 0) {
+      close(fds[0]);
+      Replay_GNSS_fd = fds[1];
+#if defined(USE_GNSS_THREAD)
+      pthread_t gnss_reader_thread;
+      if (pthread_create(&gnss_reader_thread, NULL, gnss_reader_loop, (void *)0) != 0) {
+        fprintf( stderr, "pthread_create(gnss_reader_thread) Failed\n\n" );
+        exit(EXIT_FAILURE);
+      }
+#endif /* USE_GNSS_THREAD */
+    }
+#endif
+
+    RPi_Replay(replay_log, replay_speed);
+
+    for (int i = 0; i < OUTPUT_COUNT; i++) {
+      if (Output_Capture[i]) {
+        fclose(Output_Capture[i]);
+      }
+    }
+    fclose(replay_log);
+
+    return 0;
+  }
+
   Traffic_TCP_Server.setup(JSON_SRV_TCP_PORT);
 
+  /* a gone TCP export client must not terminate the process */
+  signal(SIGPIPE, SIG_IGN);
+
   pthread_t traffic_tcpserv_thread;
 	if( pthread_create(&traffic_tcpserv_thread, NULL, traffic_tcpserv_loop, (void *)0) != 0) {
     fprintf( stderr, "pthread_create(traffic_tcpserv_thread) Failed\n\n" );
     exit(EXIT_FAILURE);
   }
 
+  pthread_t metrics_serv_thread;
+  if (pthread_create(&metrics_serv_thread, NULL, metrics_serv_loop, (void *)0) != 0) {
+    fprintf( stderr, "pthread_create(metrics_serv_thread) Failed\n\n" );
+    exit(EXIT_FAILURE);
+  }
+
+#if defined(USE_GNSS_THREAD)
+  pthread_t gnss_reader_thread;
+  if (pthread_create(&gnss_reader_thread, NULL, gnss_reader_loop, (void *)0) != 0) {
+    fprintf( stderr, "pthread_create(gnss_reader_thread) Failed\n\n" );
+    exit(EXIT_FAILURE);
+  }
+#endif /* USE_GNSS_THREAD */
+
   while (true) {
     switch (settings->mode)
     {
@@ -721,6 +1574,8 @@ int main()
       normal_loop();
       break;
     }
+
+    Output_loop();
   }
 
   Traffic_TCP_Server.detach();
@@ -22,7 +22,7 @@
 #define PLATFORM_RPI_H
 
 /* Maximum of tracked flying objects is now SoC-specific constant */
-#define MAX_TRACKING_OBJECTS  8
+#define MAX_TRACKING_OBJECTS  1024  /* ground stations, ADS-B and OGN */
 
 //#include <raspi/HardwareSerial.h>
 #include <raspi/TTYSerial.h>
@@ -75,6 +75,13 @@ extern TTYSerial Serial2;
 
 #define  USE_NMEALIB
 
+/* read standard input on a thread of its own, see RPi_PickGNSSFix() */
+#if !defined(NO_GNSS_THREAD)
+#define  USE_GNSS_THREAD
+#endif
+#define  GNSS_READ_BUFSIZE    1024
+#define  GNSS_LINES_MAX       64    /* lines pending for the main loop */
+
 #endif /* PLATFORM_RPI_H */
 
 #endif /* RASPBERRY_PI */
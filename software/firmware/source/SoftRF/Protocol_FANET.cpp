@@ -237,7 +237,7 @@ bool fanet_decode(void *fanet_pkt, ufo_t *this_aircraft, ufo_t *fop) {
     if (pkt->speed_scale) {
       speed_int *= 5 /* -2 */;
     }
-    fop->speed = ((float) speed_int) / (2 * _GPS_KMPH_PER_KNOT);
+    fop->speed = cms_to_knots((speed_int * 250) / 18); /* 0.5 km/h */
 
     climb_byte = pkt->climb;
     climb_int = (int) (climb_byte | (climb_byte & (1<<6) ? 0xFFFFFF80U : 0));
@@ -245,7 +245,7 @@ bool fanet_decode(void *fanet_pkt, ufo_t *this_aircraft, ufo_t *fop) {
     if (pkt->climb_scale) {
       climb_int *= 5 /* +-2 */;
     }
-    fop->vs = ((float)climb_int) * (_GPS_FEET_PER_METER * 6.0);
+    fop->vs = cms_to_fpm(climb_int * 10);
 
     fop->addr_type = ADDR_TYPE_FANET;
     fop->timestamp = this_aircraft->timestamp;
@@ -288,7 +288,7 @@ size_t fanet_encode(void *fanet_pkt, ufo_t *this_aircraft) {
   int16_t alt = (int16_t) this_aircraft->altitude;
   unsigned int aircraft_type =  this_aircraft->aircraft_type;
   float speed = this_aircraft->speed * _GPS_KMPH_PER_KNOT;
-  float climb = this_aircraft->vs / (_GPS_FEET_PER_METER * 60.0);
+  float climb = fpm_to_cms(this_aircraft->vs) * 0.01f;
   float heading = this_aircraft->course;
   float turnrate = 0;
 
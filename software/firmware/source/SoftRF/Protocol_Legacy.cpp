@@ -28,6 +28,7 @@
 #include "RFHelper.h"
 #include "Protocol_Legacy.h"
 #include "EEPROMHelper.h"
+#include "TrafficHelper.h"
 
 const rf_proto_desc_t legacy_proto_desc = {
   "Legacy",
@@ -140,18 +141,24 @@ bool legacy_decode(void *legacy_pkt, ufo_t *this_aircraft, ufo_t *fop) {
         return false;
     }
 
-    int32_t round_lat = (int32_t) (ref_lat * 1e7) >> 7;
+    int32_t round_lat = deg_to_deg7(ref_lat) >> 7;
     int32_t lat = (pkt->lat - round_lat) % (uint32_t) 0x080000;
     if (lat >= 0x040000) lat -= 0x080000;
     lat = ((lat + round_lat) << 7) /* + 0x40 */;
 
-    int32_t round_lon = (int32_t) (ref_lon * 1e7) >> 7;
+    int32_t round_lon = deg_to_deg7(ref_lon) >> 7;
     int32_t lon = (pkt->lon - round_lon) % (uint32_t) 0x100000;
     if (lon >= 0x080000) lon -= 0x100000;
     lon = ((lon + round_lon) << 7) /* + 0x40 */;
 
-    int32_t ns = (pkt->ns[0] + pkt->ns[1] + pkt->ns[2] + pkt->ns[3]) / 4;
-    int32_t ew = (pkt->ew[0] + pkt->ew[1] + pkt->ew[2] + pkt->ew[3]) / 4;
+    /*
+     * The first vector is the current one. SoftRF projects the other three
+     * ahead along the turn of the sender, LEGACY_NSEW_INTERVAL apart, so their
+     * average would run ahead of the course and shorten the speed in a turn.
+     * In straight flight all four are the same and either way gives one result.
+     */
+    int32_t ns = pkt->ns[0];
+    int32_t ew = pkt->ew[0];
     float speed4 = sqrtf(ew * ew + ns * ns) * (1 << pkt->smult);
 
     float direction = 0;
@@ -173,12 +180,12 @@ bool legacy_decode(void *legacy_pkt, ufo_t *this_aircraft, ufo_t *fop) {
     fop->addr = pkt->addr;
     fop->addr_type = pkt->addr_type;
     fop->timestamp = timestamp;
-    fop->latitude = (float)lat / 1e7;
-    fop->longitude = (float)lon / 1e7;
+    fop->latitude = deg7_to_deg(lat);
+    fop->longitude = deg7_to_deg(lon);
     fop->altitude = (float) alt - geo_separ;
-    fop->speed = speed4 / (4 * _GPS_MPS_PER_KNOT);
+    fop->speed = cms_to_knots((int32_t) (speed4 * 25));
     fop->course = direction;
-    fop->vs = ((float) vs10) * (_GPS_FEET_PER_METER * 6.0);
+    fop->vs = cms_to_fpm(vs10 * 10);
     fop->aircraft_type = pkt->aircraft_type;
     fop->stealth = pkt->stealth;
     fop->no_track = pkt->no_track;
@@ -186,6 +193,7 @@ bool legacy_decode(void *legacy_pkt, ufo_t *this_aircraft, ufo_t *fop) {
     fop->ns[2] = pkt->ns[2]; fop->ns[3] = pkt->ns[3];
     fop->ew[0] = pkt->ew[0]; fop->ew[1] = pkt->ew[1];
     fop->ew[2] = pkt->ew[2]; fop->ew[3] = pkt->ew[3];
+    fop->smult = pkt->smult;
 
     return true;
 }
@@ -205,10 +213,10 @@ size_t legacy_encode(void *legacy_pkt, ufo_t *this_aircraft) {
     uint32_t timestamp = (uint32_t) this_aircraft->timestamp;
 
     float course = this_aircraft->course;
-    float speedf = this_aircraft->speed * _GPS_MPS_PER_KNOT; /* m/s */
-    float vsf = this_aircraft->vs / (_GPS_FEET_PER_METER * 60.0); /* m/s */
+    int32_t speed_cms = knots_to_cms(this_aircraft->speed);
+    int32_t vs_cms = fpm_to_cms(this_aircraft->vs);
 
-    uint16_t speed4 = (uint16_t) roundf(speedf * 4.0f);
+    uint16_t speed4 = (uint16_t) ((speed_cms + 12) / 25);
     if (speed4 > 0x3FF) {
       speed4 = 0x3FF;
     }
@@ -225,10 +233,18 @@ size_t legacy_encode(void *legacy_pkt, ufo_t *this_aircraft) {
 
     uint8_t speed = speed4 >> pkt->smult;
 
-    int8_t ns = (int8_t) (speed * cosf(radians(course)));
-    int8_t ew = (int8_t) (speed * sinf(radians(course)));
+    /* project the velocity along the turn of the aircraft */
+    float turn = this_aircraft->turn * LEGACY_NSEW_INTERVAL;
+    int8_t ns[4], ew[4];
 
-    int16_t vs10 = (int16_t) roundf(vsf * 10.0f);
+    for (ndx = 0; ndx < 4; ndx++) {
+      float c = radians(course + turn * ndx);
+
+      ns[ndx] = (int8_t) (speed * cosf(c));
+      ew[ndx] = (int8_t) (speed * sinf(c));
+    }
+
+    int16_t vs10 = (int16_t) ((vs_cms + (vs_cms < 0 ? -5 : 5)) / 10);
     pkt->vs = vs10 >> pkt->smult;
 
     pkt->addr = id & 0x00FFFFFF;
@@ -249,13 +265,13 @@ size_t legacy_encode(void *legacy_pkt, ufo_t *this_aircraft) {
 
     pkt->gps = 323;
 
-    pkt->lat = (uint32_t ( lat * 1e7) >> 7) & 0x7FFFF;
-    pkt->lon = (uint32_t ( lon * 1e7) >> 7) & 0xFFFFF;
+    pkt->lat = ((uint32_t) deg_to_deg7(lat) >> 7) & 0x7FFFF;
+    pkt->lon = ((uint32_t) deg_to_deg7(lon) >> 7) & 0xFFFFF;
     pkt->alt = alt;
 
     pkt->airborne = speed > 0 ? 1 : 0;
-    pkt->ns[0] = ns; pkt->ns[1] = ns; pkt->ns[2] = ns; pkt->ns[3] = ns;
-    pkt->ew[0] = ew; pkt->ew[1] = ew; pkt->ew[2] = ew; pkt->ew[3] = ew;
+    pkt->ns[0] = ns[0]; pkt->ns[1] = ns[1]; pkt->ns[2] = ns[2]; pkt->ns[3] = ns[3];
+    pkt->ew[0] = ew[0]; pkt->ew[1] = ew[1]; pkt->ew[2] = ew[2]; pkt->ew[3] = ew[3];
 
     pkt->_unk0 = 0;
     pkt->_unk1 = 0;
@@ -85,14 +85,14 @@ bool ogntp_decode(void *pkt, ufo_t *this_aircraft, ufo_t *fop) {
   fop->protocol = RF_PROTOCOL_OGNTP;
 
   fop->addr = ogn_rx_pkt.Packet.Header.Address;
-  fop->latitude = ogn_rx_pkt.Packet.DecodeLatitude() * 0.0001/60;
-  fop->longitude = ogn_rx_pkt.Packet.DecodeLongitude() * 0.0001/60;
+  fop->latitude = ogn_rx_pkt.Packet.DecodeLatitude() * (0.0001f / 60);
+  fop->longitude = ogn_rx_pkt.Packet.DecodeLongitude() * (0.0001f / 60);
   fop->altitude = (float) ogn_rx_pkt.Packet.DecodeAltitude();
   fop->pressure_altitude = (float) ogn_rx_pkt.Packet.DecodeStdAltitude();
   fop->aircraft_type = ogn_rx_pkt.Packet.Position.AcftType;
-  fop->course = ogn_rx_pkt.Packet.DecodeHeading() * 0.1;
-  fop->speed = (ogn_rx_pkt.Packet.DecodeSpeed() * 0.1) / _GPS_MPS_PER_KNOT;
-  fop->vs = (ogn_rx_pkt.Packet.DecodeClimbRate() * 0.1) * (_GPS_FEET_PER_METER * 60.0);
+  fop->course = ogn_rx_pkt.Packet.DecodeHeading() * 0.1f;
+  fop->speed = cms_to_knots(ogn_rx_pkt.Packet.DecodeSpeed() * 10);
+  fop->vs = cms_to_fpm(ogn_rx_pkt.Packet.DecodeClimbRate() * 10);
   fop->hdop = (ogn_rx_pkt.Packet.DecodeDOP() + 10) * 10;
 
   fop->addr_type = ogn_rx_pkt.Packet.Header.AddrType;
@@ -112,13 +112,13 @@ size_t ogntp_encode(void *pkt, ufo_t *this_aircraft) {
 
   pos.Latitude = (int32_t) (this_aircraft->latitude * 600000);
   pos.Longitude = (int32_t) (this_aircraft->longitude * 600000);
-  pos.Altitude = (int32_t) (this_aircraft->altitude * 10);
+  pos.Altitude = m_to_dm(this_aircraft->altitude);
   if (this_aircraft->pressure_altitude == 0.0) {
-    pos.StdAltitude = (int32_t) (this_aircraft->pressure_altitude * 10);
-    pos.ClimbRate = (int32_t) (this_aircraft->vs / (_GPS_FEET_PER_METER * 6.0));
+    pos.StdAltitude = m_to_dm(this_aircraft->pressure_altitude);
+    pos.ClimbRate = fpm_to_cms(this_aircraft->vs) / 10;
   }
   pos.Heading = (int16_t) (this_aircraft->course * 10);
-  pos.Speed = (int16_t) (this_aircraft->speed * 10 * _GPS_MPS_PER_KNOT);
+  pos.Speed = (int16_t) (knots_to_cms(this_aircraft->speed) / 10);
   pos.HDOP = (uint8_t) (this_aircraft->hdop / 10);
 
   pos.Encode(ogn_tx_pkt.Packet);
@@ -64,10 +64,10 @@ bool uat978_decode(void *pkt, ufo_t *this_aircraft, ufo_t *fop) {
   fop->longitude = mdb.lon;
 
   if (mdb.altitude_type == ALT_GEO) {
-    fop->altitude = mdb.altitude / _GPS_FEET_PER_METER;          /* TBD */
+    fop->altitude = ft_to_m(mdb.altitude);          /* TBD */
   }
   if (mdb.altitude_type == ALT_BARO) {
-    fop->pressure_altitude = mdb.altitude / _GPS_FEET_PER_METER; /* TBD */
+    fop->pressure_altitude = ft_to_m(mdb.altitude); /* TBD */
   }
 
   fop->aircraft_type = GDL90_TO_AT(mdb.emitter_category);
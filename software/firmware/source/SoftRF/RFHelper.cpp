@@ -29,6 +29,8 @@
 #include "EEPROMHelper.h"
 #include "WebHelper.h"
 #include "MAVLinkHelper.h"
+#include "MetricsHelper.h"
+#include "AirtimeHelper.h"
 #include <fec.h>
 
 #if LOGGER_IS_ENABLED
@@ -44,6 +46,8 @@ uint32_t tx_packets_counter = 0;
 uint32_t rx_packets_counter = 0;
 
 int8_t RF_last_rssi = 0;
+uint8_t RF_last_errors = 0;
+uint32_t RF_rx_us = 0;
 
 static FreqPlan RF_FreqPlan;
 static bool RF_ready = false;
@@ -169,9 +173,11 @@ void RF_SetChannel(void)
     unsigned long pps_btime_ms = SoC->get_PPS_TimeMarker();
     unsigned long time_corr_pos = 0;
     unsigned long time_corr_neg = 0;
+    bool decoded = isValidDecodedFix();
+    unsigned long time_age = decoded ? millis() - GNSS_Decoded.ms : gnss.time.age();
 
     if (pps_btime_ms) {
-      unsigned long lastCommitTime = millis() - gnss.time.age();
+      unsigned long lastCommitTime = millis() - time_age;
       if (pps_btime_ms <= lastCommitTime) {
         time_corr_neg = (lastCommitTime - pps_btime_ms) % 1000;
       } else {
@@ -180,19 +186,19 @@ void RF_SetChannel(void)
       time_corr_pos = 400; /* 400 ms after PPS for V6, 350 ms - for OGNTP */
     }
 
-    int yr = gnss.date.year();
+    int yr = decoded ? GNSS_Decoded.year : gnss.date.year();
     if( yr > 99)
         yr = yr - 1970;
     else
         yr += 30;
     tm.Year = yr;
-    tm.Month = gnss.date.month();
-    tm.Day = gnss.date.day();
-    tm.Hour = gnss.time.hour();
-    tm.Minute = gnss.time.minute();
-    tm.Second = gnss.time.second();
+    tm.Month = decoded ? GNSS_Decoded.month : gnss.date.month();
+    tm.Day = decoded ? GNSS_Decoded.day : gnss.date.day();
+    tm.Hour = decoded ? GNSS_Decoded.hour : gnss.time.hour();
+    tm.Minute = decoded ? GNSS_Decoded.minute : gnss.time.minute();
+    tm.Second = decoded ? GNSS_Decoded.second : gnss.time.second();
 
-    Time = makeTime(tm) + (gnss.time.age() - time_corr_neg + time_corr_pos)/ 1000;
+    Time = makeTime(tm) + (time_age - time_corr_neg + time_corr_pos)/ 1000;
     break;
   }
 
@@ -230,6 +236,10 @@ void RF_loop()
     } else {
       RF_ready = true;
     }
+
+    if (RF_ready) {
+      Airtime_setup(RF_FreqPlan.Plan);
+    }
   }
 
   if (RF_ready) {
@@ -253,6 +263,13 @@ size_t RF_Encode(ufo_t *fop)
   return size;
 }
 
+static long RF_TxInterval()
+{
+  return (LMIC.protocol ?
+    SoC->random(LMIC.protocol->tx_interval_min, LMIC.protocol->tx_interval_max) :
+    SoC->random(LEGACY_TX_INTERVAL_MIN, LEGACY_TX_INTERVAL_MAX));
+}
+
 bool RF_Transmit(size_t size, bool wait)
 {
   if (RF_ready && rf_chip && (size > 0)) {
@@ -264,6 +281,16 @@ bool RF_Transmit(size_t size, bool wait)
 
     if (!wait || (millis() - TxTimeMarker) > TxRandomValue) {
 
+      uint32_t airtime = Airtime_us(settings->rf_protocol, size);
+
+      if (!Airtime_Permit(airtime)) {
+        /* out of duty cycle budget - give up this slot */
+        TxRandomValue = RF_TxInterval();
+        TxTimeMarker = millis();
+
+        return false;
+      }
+
       time_t timestamp = now();
 
       rf_chip->transmit();
@@ -276,11 +303,10 @@ bool RF_Transmit(size_t size, bool wait)
                                RF_Payload_Size(settings->rf_protocol)));
       }
       tx_packets_counter++;
+      Airtime_Add(airtime);
       RF_tx_size = 0;
 
-      TxRandomValue = (LMIC.protocol ?
-        SoC->random(LMIC.protocol->tx_interval_min, LMIC.protocol->tx_interval_max) :
-        SoC->random(LEGACY_TX_INTERVAL_MIN, LEGACY_TX_INTERVAL_MAX));
+      TxRandomValue = RF_TxInterval();
 
       TxTimeMarker = millis();
 
@@ -295,9 +321,14 @@ bool RF_Receive(void)
   bool rval = false;
 
   if (RF_ready && rf_chip) {
+    RF_last_errors = 0;
     rval = rf_chip->receive();
   }
-  
+
+  if (rval) {
+    RF_rx_us = micros();
+  }
+
   return rval;
 }
 
@@ -308,19 +339,26 @@ void RF_Shutdown(void)
   }
 }
 
-uint8_t RF_Payload_Size(uint8_t protocol)
+const rf_proto_desc_t *RF_Protocol_Desc(uint8_t protocol)
 {
   switch (protocol)
   {
-    case RF_PROTOCOL_LEGACY:    return legacy_proto_desc.payload_size;
-    case RF_PROTOCOL_OGNTP:     return ogntp_proto_desc.payload_size;
-    case RF_PROTOCOL_P3I:       return p3i_proto_desc.payload_size;
-    case RF_PROTOCOL_FANET:     return fanet_proto_desc.payload_size;
-    case RF_PROTOCOL_ADSB_UAT:  return uat978_proto_desc.payload_size;
-    default:                    return 0;
+    case RF_PROTOCOL_LEGACY:    return &legacy_proto_desc;
+    case RF_PROTOCOL_OGNTP:     return &ogntp_proto_desc;
+    case RF_PROTOCOL_P3I:       return &p3i_proto_desc;
+    case RF_PROTOCOL_FANET:     return &fanet_proto_desc;
+    case RF_PROTOCOL_ADSB_UAT:  return &uat978_proto_desc;
+    default:                    return NULL;
   }
 }
 
+uint8_t RF_Payload_Size(uint8_t protocol)
+{
+  const rf_proto_desc_t *rf = RF_Protocol_Desc(protocol);
+
+  return rf ? rf->payload_size : 0;
+}
+
 /*
  * NRF905-specific code
  *
@@ -748,6 +786,7 @@ static void sx1276_rx_func (osjob_t* job) {
 
   /* FANET (LoRa) LMIC IRQ handler may deliver empty packets here when CRC is invalid. */
   if (LMIC.dataLen == 0) {
+    METRIC_INC_PROTOCOL(rx_crc_errors, LMIC.protocol->type);
     return;
   }
 
@@ -874,6 +913,10 @@ static void sx1276_rx_func (osjob_t* job) {
     break;
   }
 
+  if (!sx1276_receive_complete) {
+    METRIC_INC_PROTOCOL(rx_crc_errors, LMIC.protocol->type);
+  }
+
 #if DEBUG
   Serial.println();
 #endif
@@ -1132,6 +1175,7 @@ bool cc13xx_receive()
       }
 
       RF_last_rssi = uatradio_frame.rssi;
+      RF_last_errors = rs_errors > 0 ? rs_errors : 0;
       rx_packets_counter++;
 
       success = true;
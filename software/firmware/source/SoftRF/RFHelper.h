@@ -86,6 +86,7 @@ bool    RF_Transmit(size_t, bool);
 bool    RF_Receive(void);
 void    RF_Shutdown(void);
 uint8_t RF_Payload_Size(uint8_t);
+const rf_proto_desc_t *RF_Protocol_Desc(uint8_t);
 
 bool nrf905_probe(void);
 void nrf905_setup(void);
@@ -118,5 +119,7 @@ extern size_t (*protocol_encode)(void *, ufo_t *);
 extern bool (*protocol_decode)(void *, ufo_t *, ufo_t *);
 
 extern int8_t RF_last_rssi;
+extern uint8_t RF_last_errors;  /* corrected by FEC, UAT only */
+extern uint32_t RF_rx_us;
 
 #endif /* RFHELPER_H */
@@ -0,0 +1,155 @@
+/*
+ * RelayHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <TimeLib.h>
+
+#include "SoCHelper.h"
+#include "RelayHelper.h"
+#include "EEPROMHelper.h"
+#include "AirtimeHelper.h"
+
+static relay_frame_t Relay_Queue[RELAY_QUEUE_SIZE];
+
+relay_stats_t Relay_Stats;
+
+#define isTimeToRelayStats() (millis() - RelayStatsTimeMarker > RELAY_STATS_INTERVAL_MS)
+static unsigned long RelayStatsTimeMarker = 0;
+
+static unsigned long RelayTxTimeMarker = 0;
+static unsigned long RelayTxInterval = 0;
+
+static relay_frame_t *Relay_Oldest()
+{
+  relay_frame_t *oldest = NULL;
+
+  for (int i=0; i < RELAY_QUEUE_SIZE; i++) {
+    if (Relay_Queue[i].size &&
+        (oldest == NULL || Relay_Queue[i].queued_ms < oldest->queued_ms)) {
+      oldest = &Relay_Queue[i];
+    }
+  }
+
+  return oldest;
+}
+
+/*
+ * Put a ready-to-transmit frame into the queue.
+ * A pending frame of the same aircraft (or an identical raw frame)
+ * is refreshed in place and keeps its position in the queue.
+ */
+bool Relay_Enqueue(const uint8_t *buf, size_t size, uint8_t protocol,
+                   uint32_t addr, int8_t rssi)
+{
+  relay_frame_t *slot = NULL;
+
+  if (size == 0 || size > MAX_PKT_SIZE) {
+    return false;
+  }
+
+  for (int i=0; i < RELAY_QUEUE_SIZE; i++) {
+    relay_frame_t *rfp = &Relay_Queue[i];
+
+    if (rfp->size && rfp->protocol == protocol &&
+        (addr ? rfp->addr == addr :
+                rfp->size == size && !memcmp(rfp->raw, buf, size))) {
+      slot = rfp;
+      Relay_Stats.dup++;
+      break;
+    }
+  }
+
+  if (slot == NULL) {
+    for (int i=0; i < RELAY_QUEUE_SIZE; i++) {
+      if (Relay_Queue[i].size == 0) {
+        slot = &Relay_Queue[i];
+        break;
+      }
+    }
+
+    if (slot == NULL) {
+      /* queue is full - sacrifice the oldest frame */
+      slot = Relay_Oldest();
+      Relay_Stats.dropped++;
+    } else {
+      Relay_Stats.depth++;
+    }
+
+    slot->queued_ms = millis();
+  }
+
+  memcpy(slot->raw, buf, size);
+  slot->size     = size;
+  slot->protocol = protocol;
+  slot->addr     = addr;
+  slot->rssi     = rssi;
+  slot->rx_ms    = millis();
+
+  Relay_Stats.rx++;
+  if (Relay_Stats.depth > Relay_Stats.depth_max) {
+    Relay_Stats.depth_max = Relay_Stats.depth;
+  }
+
+  return true;
+}
+
+void Relay_loop()
+{
+  for (int i=0; i < RELAY_QUEUE_SIZE; i++) {
+    if (Relay_Queue[i].size &&
+        millis() - Relay_Queue[i].rx_ms > RELAY_FRAME_TTL_MS) {
+      Relay_Queue[i].size = 0;
+      Relay_Stats.depth--;
+      Relay_Stats.dropped++;
+    }
+  }
+
+  /*
+   * Oldest first, paced to spend the duty cycle budget evenly
+   * rather than at the random interval of own position reports.
+   * RF_Transmit() refuses a frame the budget has no room for.
+   */
+  relay_frame_t *rfp = Relay_Oldest();
+
+  if (rfp && millis() - RelayTxTimeMarker >= RelayTxInterval) {
+    uint32_t pace_ms = Airtime_Pace_ms(Airtime_us(rfp->protocol, rfp->size));
+
+    memcpy(TxBuffer, rfp->raw, rfp->size);
+
+    if (RF_Transmit(rfp->size, false)) {
+      rfp->size = 0;
+      Relay_Stats.depth--;
+      Relay_Stats.tx++;
+    }
+
+    RelayTxInterval   = maxof2(pace_ms, RELAY_TX_GAP_MS);
+    RelayTxTimeMarker = millis();
+  }
+
+  if (settings->nmea_p && isTimeToRelayStats()) {
+    StdOut.print(F("$PSRFR,"));
+    StdOut.print((unsigned long) now());      StdOut.print(F(","));
+    StdOut.print(Relay_Stats.rx);             StdOut.print(F(","));
+    StdOut.print(Relay_Stats.tx);             StdOut.print(F(","));
+    StdOut.print(Relay_Stats.dup);            StdOut.print(F(","));
+    StdOut.print(Relay_Stats.dropped);        StdOut.print(F(","));
+    StdOut.print(Relay_Stats.depth);          StdOut.print(F(","));
+    StdOut.println(Relay_Stats.depth_max);
+
+    RelayStatsTimeMarker = millis();
+  }
+}
@@ -0,0 +1,53 @@
+/*
+ * RelayHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RELAYHELPER_H
+#define RELAYHELPER_H
+
+#include "RFHelper.h"
+
+#define RELAY_QUEUE_SIZE        16
+#define RELAY_FRAME_TTL_MS      3000  /* stale position data is not relayed */
+#define RELAY_STATS_INTERVAL_MS 10000
+#define RELAY_TX_GAP_MS         100   /* least time between frames */
+
+typedef struct relay_frame_struct {
+  uint8_t       raw[MAX_PKT_SIZE];
+  uint8_t       size;         /* 0 - free slot */
+  uint8_t       protocol;
+  uint32_t      addr;         /* 0 when unknown (raw input) */
+  int8_t        rssi;
+  unsigned long queued_ms;    /* first reception, defines TX order */
+  unsigned long rx_ms;        /* most recent reception */
+} relay_frame_t;
+
+typedef struct relay_stats_struct {
+  uint32_t rx;          /* frames accepted */
+  uint32_t tx;          /* frames transmitted */
+  uint32_t dup;         /* frames merged into a pending one */
+  uint32_t dropped;     /* expired or overflowed frames */
+  uint8_t  depth;
+  uint8_t  depth_max;
+} relay_stats_t;
+
+bool Relay_Enqueue(const uint8_t *, size_t, uint8_t, uint32_t, int8_t);
+void Relay_loop(void);
+
+extern relay_stats_t Relay_Stats;
+
+#endif /* RELAYHELPER_H */
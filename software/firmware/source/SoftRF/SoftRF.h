@@ -72,6 +72,31 @@
 #define ENABLE_AHRS
 #endif /* PREMIUM_PACKAGE */
 
+/*
+ * Fixed-point units of the packet codecs and exporters:
+ *   position  1e-7 degree (int32_t)
+ *   altitude  dm or ft    (int32_t)
+ *   speed     cm/s        (int32_t), climb rate as well
+ * ESP8266 and CC13XX have no FPU, so conversions take single precision
+ * constants at most - no double arithmetic, no dtostrf() on the hot path.
+ * They are used at the wire formats only: ufo_t keeps float fields, as the
+ * alarm, tracking and ranking maths is float throughout and an int32 store
+ * would add a conversion on the way in and out of each of them.
+ */
+#define UNITS_CMS_PER_KNOT      51.444444f
+#define UNITS_CMS_PER_FPM       0.508f
+#define UNITS_FT_PER_M          3.2808399f
+
+static constexpr float   deg7_to_deg (int32_t deg7) { return deg7 * 1e-7f; }
+static constexpr int32_t deg_to_deg7 (float deg)    { return (int32_t) (deg * 1e7f); }
+static constexpr int32_t m_to_dm     (float m)      { return (int32_t) (m * 10.0f); }
+static constexpr float   ft_to_m     (int32_t ft)   { return ft * (1.0f / UNITS_FT_PER_M); }
+static constexpr int32_t m_to_ft     (float m)      { return (int32_t) (m * UNITS_FT_PER_M); }
+static constexpr float   cms_to_knots(int32_t cms)  { return cms * (1.0f / UNITS_CMS_PER_KNOT); }
+static constexpr int32_t knots_to_cms(float knots)  { return (int32_t) (knots * UNITS_CMS_PER_KNOT); }
+static constexpr float   cms_to_fpm  (int32_t cms)  { return cms * (1.0f / UNITS_CMS_PER_FPM); }
+static constexpr int32_t fpm_to_cms  (float fpm)    { return (int32_t) (fpm * UNITS_CMS_PER_FPM); }
+
 typedef struct UFO {
     uint8_t   raw[34];
     time_t    timestamp;
@@ -89,16 +114,20 @@ typedef struct UFO {
     uint8_t   aircraft_type;
 
     float     vs; /* feet per minute */
+    float     turn; /* degrees per second, positive is clockwise */
 
     bool      stealth;
     bool      no_track;
+    bool      coasting;   /* position is predicted, no recent packet */
 
-    int8_t    ns[4];
+    int8_t    ns[4];      /* velocity vectors, 0.25 m/s << smult */
     int8_t    ew[4];
+    uint8_t   smult;
 
     float     geoid_separation; /* metres */
     uint16_t  hdop; /* cm */
     int8_t    rssi; /* SX1276 only */
+    uint32_t  rx_us;    /* micros() at RF reception, 0 once exported */
 
     /* 'legacy' specific data */
     float     distance;
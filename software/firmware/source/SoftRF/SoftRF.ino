@@ -68,6 +68,9 @@
 #include "BaroHelper.h"
 #include "TTNHelper.h"
 #include "TrafficHelper.h"
+#include "OutputHelper.h"
+#include "TrackHelper.h"
+#include "LatencyHelper.h"
 
 #include "SoftRF.h"
 
@@ -223,6 +226,9 @@ void loop()
     break;
   }
 
+  // Flush coalesced NMEA, GDL90 and D1090 output
+  Output_loop();
+
   // Show status info on tiny OLED display
   SoC->Display_loop();
 
@@ -253,6 +259,8 @@ void shutdown(const char *msg)
 
   SoC->swSer_enableRx(false);
 
+  Output_fini();
+
   NMEA_fini();
 
   Web_fini();
@@ -274,6 +282,8 @@ void normal_loop()
 {
   bool success;
 
+  Latency_loop();
+
   Baro_loop();
 
 #if defined(ENABLE_AHRS)
@@ -286,26 +296,31 @@ void normal_loop()
 
   ThisAircraft.timestamp = now();
   if (isValidFix()) {
-    ThisAircraft.latitude = gnss.location.lat();
-    ThisAircraft.longitude = gnss.location.lng();
-    ThisAircraft.altitude = gnss.altitude.meters();
-    ThisAircraft.course = gnss.course.deg();
-    ThisAircraft.speed = gnss.speed.knots();
-    ThisAircraft.hdop = (uint16_t) gnss.hdop.value();
-    ThisAircraft.geoid_separation = gnss.separation.meters();
-
-    /*
-     * When geoidal separation is zero or not available - use approx. EGM96 value
-     */
-    if (ThisAircraft.geoid_separation == 0.0) {
-      ThisAircraft.geoid_separation = (float) LookupSeparation(
-                                                ThisAircraft.latitude,
-                                                ThisAircraft.longitude
-                                              );
-      /* we can assume the GPS unit is giving ellipsoid height */
-      ThisAircraft.altitude -= ThisAircraft.geoid_separation;
+    /* NAV-PVT and the RPi reader thread decode straight into ThisAircraft */
+    if (!isValidDecodedFix()) {
+      ThisAircraft.latitude = gnss.location.lat();
+      ThisAircraft.longitude = gnss.location.lng();
+      ThisAircraft.altitude = gnss.altitude.meters();
+      ThisAircraft.course = gnss.course.deg();
+      ThisAircraft.speed = gnss.speed.knots();
+      ThisAircraft.hdop = (uint16_t) gnss.hdop.value();
+      ThisAircraft.geoid_separation = gnss.separation.meters();
+
+      /*
+       * When geoidal separation is zero or not available - use approx. EGM96 value
+       */
+      if (ThisAircraft.geoid_separation == 0.0) {
+        ThisAircraft.geoid_separation = (float) LookupSeparation(
+                                                  ThisAircraft.latitude,
+                                                  ThisAircraft.longitude
+                                                );
+        /* we can assume the GPS unit is giving ellipsoid height */
+        ThisAircraft.altitude -= ThisAircraft.geoid_separation;
+      }
     }
 
+    Track_loop();
+
     RF_Transmit(RF_Encode(&ThisAircraft), true);
   }
 
@@ -334,11 +349,11 @@ void normal_loop()
     LEDTimeMarker = millis();
   }
 
-  if (isTimeToExport() && isValidFix()) {
+  /* each export sink keeps its own pace, as per settings */
+  if (isValidFix()) {
     NMEA_Export();
     GDL90_Export();
     D1090_Export();
-    ExportTimeMarker = millis();
   }
 
   // Handle Air Connect
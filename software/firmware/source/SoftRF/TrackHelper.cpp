@@ -0,0 +1,181 @@
+/*
+ * TrackHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TrackHelper.h"
+#include "TrafficHelper.h"
+
+static track_sample_t Track_Samples[TRACK_HISTORY_SIZE];
+static track_key_t    Track_Keys[TRACK_KEY_COUNT];
+
+static uint32_t Track_Total = 0;  /* samples taken since the start over */
+static time_t   Track_Last_Time;
+
+/* position as it is restored from the deltas, so that errors never add up */
+static int32_t  Track_Last_Lat, Track_Last_Lon, Track_Last_Alt;
+
+static int16_t Track_Delta(int32_t *prev, int32_t value)
+{
+  int32_t d = constrain(value - *prev, -32768, 32767);
+
+  *prev += d;
+  return (int16_t) d;
+}
+
+static void Track_Add(ufo_t *fop)
+{
+  uint32_t k = Track_Total;
+  track_sample_t *sp = &Track_Samples[k % TRACK_HISTORY_SIZE];
+
+  int32_t lat = deg_to_deg7(fop->latitude);
+  int32_t lon = deg_to_deg7(fop->longitude);
+  int32_t alt = m_to_dm(fop->altitude);
+
+  if (k % TRACK_KEY_INTERVAL == 0) {
+    track_key_t *kp = &Track_Keys[(k / TRACK_KEY_INTERVAL) % TRACK_KEY_COUNT];
+
+    kp->timestamp  = fop->timestamp;
+    kp->latitude   = Track_Last_Lat = lat;
+    kp->longitude  = Track_Last_Lon = lon;
+    kp->altitude   = Track_Last_Alt = alt;
+
+    sp->dlat = sp->dlon = sp->dalt = 0;
+  } else {
+    sp->dlat = Track_Delta(&Track_Last_Lat, lat);
+    sp->dlon = Track_Delta(&Track_Last_Lon, lon);
+    sp->dalt = Track_Delta(&Track_Last_Alt, alt);
+  }
+
+  sp->course = (uint16_t) (fop->course * 100);
+  sp->speed  = (uint8_t) constrain((int) fop->speed, 0, 255);
+  sp->dt     = k ? (uint8_t) (fop->timestamp - Track_Last_Time) : 0;
+
+  Track_Last_Time = fop->timestamp;
+  Track_Total++;
+}
+
+void Track_loop()
+{
+  if (ThisAircraft.timestamp == Track_Last_Time && Track_Total > 0) {
+    return;
+  }
+
+  if (Track_Total > 0 &&
+      ThisAircraft.timestamp - Track_Last_Time > TRACK_MAX_GAP) {
+    Track_Total = 0;
+  }
+
+  Track_Add(&ThisAircraft);
+  ThisAircraft.turn = Track_TurnRate();
+}
+
+/* number of samples that can be restored, their key frames are still kept */
+int Track_Count()
+{
+  if (Track_Total <= TRACK_HISTORY_SIZE) {
+    return Track_Total;
+  }
+
+  uint32_t oldest = Track_Total - TRACK_HISTORY_SIZE;
+  oldest = ((oldest + TRACK_KEY_INTERVAL - 1) / TRACK_KEY_INTERVAL) *
+           TRACK_KEY_INTERVAL;
+
+  return Track_Total - oldest;
+}
+
+/* restore the sample taken n samples ago, 0 is the latest one */
+bool Track_Get(int n, track_point_t *tp)
+{
+  if (n < 0 || n >= Track_Count()) {
+    return false;
+  }
+
+  uint32_t k = Track_Total - 1 - n;
+  uint32_t base = k - k % TRACK_KEY_INTERVAL;
+  track_key_t *kp = &Track_Keys[(base / TRACK_KEY_INTERVAL) % TRACK_KEY_COUNT];
+
+  time_t  timestamp = kp->timestamp;
+  int32_t lat = kp->latitude;
+  int32_t lon = kp->longitude;
+  int32_t alt = kp->altitude;
+
+  for (uint32_t j = base + 1; j <= k; j++) {
+    track_sample_t *sp = &Track_Samples[j % TRACK_HISTORY_SIZE];
+
+    timestamp += sp->dt;
+    lat += sp->dlat;
+    lon += sp->dlon;
+    alt += sp->dalt;
+  }
+
+  track_sample_t *sp = &Track_Samples[k % TRACK_HISTORY_SIZE];
+
+  tp->timestamp = timestamp;
+  tp->latitude  = deg7_to_deg(lat);
+  tp->longitude = deg7_to_deg(lon);
+  tp->altitude  = alt * 0.1f;
+  tp->course    = sp->course * 0.01f;
+  tp->speed     = sp->speed;
+
+  return true;
+}
+
+/* degrees per second over TRACK_RATE_WINDOW, positive is clockwise */
+float Track_TurnRate()
+{
+  track_point_t now_p, then_p;
+
+  int n = Track_Count() - 1;
+
+  if (n > TRACK_RATE_WINDOW) {
+    n = TRACK_RATE_WINDOW;
+  }
+
+  if (!Track_Get(0, &now_p) || !Track_Get(n, &then_p) ||
+      now_p.timestamp == then_p.timestamp ||
+      now_p.speed < TRACK_TURN_MIN_SPEED) {
+    return 0;
+  }
+
+  float dc = now_p.course - then_p.course;
+
+  if (dc >  180.0) dc -= 360.0;
+  if (dc < -180.0) dc += 360.0;
+
+  return constrain(dc / (now_p.timestamp - then_p.timestamp),
+                   -TRACK_TURN_RATE_MAX, TRACK_TURN_RATE_MAX);
+}
+
+/* metres per second over TRACK_RATE_WINDOW */
+float Track_ClimbRate()
+{
+  track_point_t now_p, then_p;
+
+  int n = Track_Count() - 1;
+
+  if (n > TRACK_RATE_WINDOW) {
+    n = TRACK_RATE_WINDOW;
+  }
+
+  if (!Track_Get(0, &now_p) || !Track_Get(n, &then_p) ||
+      now_p.timestamp == then_p.timestamp) {
+    return ThisAircraft.vs / (UNITS_FT_PER_M * 60.0f);
+  }
+
+  return (now_p.altitude - then_p.altitude) /
+         (now_p.timestamp - then_p.timestamp);
+}
@@ -0,0 +1,73 @@
+/*
+ * TrackHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACKHELPER_H
+#define TRACKHELPER_H
+
+#include "SoftRF.h"
+
+/*
+ * Own-ship history, 1 Hz. Every sample holds the deltas from the previous
+ * one, every TRACK_KEY_INTERVAL-th sample is accompanied by an absolute
+ * key frame. 10 bytes per second of flight.
+ */
+#if defined(ENERGIA_ARCH_CC13XX)
+#define TRACK_HISTORY_SIZE      120   /* samples */
+#else
+#define TRACK_HISTORY_SIZE      300
+#endif
+#define TRACK_KEY_INTERVAL      30    /* samples */
+#define TRACK_KEY_COUNT         (TRACK_HISTORY_SIZE / TRACK_KEY_INTERVAL + 1)
+#define TRACK_MAX_GAP           10    /* seconds, a longer one starts over */
+#define TRACK_RATE_WINDOW       4     /* seconds, for turn and climb rates */
+#define TRACK_TURN_RATE_MAX     30    /* degrees per second */
+#define TRACK_TURN_MIN_SPEED    5     /* knots, course is noisy below */
+
+typedef struct track_sample_struct {
+  int16_t   dlat;       /* 1e-7 degree, from the previous sample */
+  int16_t   dlon;
+  int16_t   dalt;       /* dm */
+  uint16_t  course;     /* 0.01 degree */
+  uint8_t   speed;      /* knots */
+  uint8_t   dt;         /* seconds from the previous sample */
+} track_sample_t;
+
+typedef struct track_key_struct {
+  time_t    timestamp;
+  int32_t   latitude;   /* 1e-7 degree */
+  int32_t   longitude;
+  int32_t   altitude;   /* dm */
+} track_key_t;
+
+/* a sample decoded from the history */
+typedef struct track_point_struct {
+  time_t    timestamp;
+  float     latitude;
+  float     longitude;
+  float     altitude;   /* metres */
+  float     course;
+  float     speed;      /* knots */
+} track_point_t;
+
+void  Track_loop(void);
+int   Track_Count(void);
+bool  Track_Get(int, track_point_t *);
+float Track_TurnRate(void);
+float Track_ClimbRate(void);
+
+#endif /* TRACKHELPER_H */
@@ -22,6 +22,10 @@
 #include "GNSSHelper.h"
 #include "WebHelper.h"
 #include "Protocol_Legacy.h"
+#include "TrackHelper.h"
+#include "LatencyHelper.h"
+#include "MetricsHelper.h"
+#include "LinkHelper.h"
 
 #include "SoftRF.h"
 
@@ -29,8 +33,106 @@ unsigned long UpdateTrafficTimeMarker = 0;
 
 ufo_t fo, Container[MAX_TRACKING_OBJECTS], EmptyFO;
 
+/* alpha-beta tracker state */
+typedef struct traffic_track_struct {
+  uint32_t      addr;
+  unsigned long ms;         /* millis() of the last packet */
+  float         latitude;   /* filtered, at ms */
+  float         longitude;
+  float         vn;         /* filtered velocity, m/s */
+  float         ve;
+} traffic_track_t;
+
+static traffic_track_t Tracker[MAX_TRACKING_OBJECTS];
+
+traffic_fusion_t Traffic_Fusion[MAX_TRACKING_OBJECTS];
+
+uint16_t Traffic_Ranking[MAX_TRACKING_OBJECTS];
+uint16_t Traffic_Ranked = 0;
+static float Traffic_TCPA[MAX_TRACKING_OBJECTS];
+static bool  Traffic_In_Ranking[MAX_TRACKING_OBJECTS];
+static bool  Traffic_Rank_Changed[MAX_TRACKING_OBJECTS];
+
 static int8_t (*Alarm_Level)(ufo_t *, ufo_t *);
 
+const uint16_t export_interval_ms[EXPORT_RATE_COUNT] = {
+  1000, 500, 200, 100, 2000, 5000
+};
+
+/* last state of every target as it has been sent to each export sink */
+typedef struct export_snapshot_struct {
+  uint32_t      addr;
+  float         latitude;
+  float         longitude;
+  float         altitude;
+  float         course;
+  float         speed;
+  int8_t        alarm_level;
+  unsigned long timestamp;
+} export_snapshot_t;
+
+static export_snapshot_t ExportSnapshot[EXPORT_SINK_COUNT][MAX_TRACKING_OBJECTS];
+
+/* short track history of an aircraft, for the turn-aware predictor */
+typedef struct traffic_history_struct {
+  uint32_t  addr;
+  uint8_t   head;
+  uint8_t   count;
+  time_t    timestamp[TRAFFIC_HISTORY_SIZE];
+  float     course[TRAFFIC_HISTORY_SIZE];
+  float     altitude[TRAFFIC_HISTORY_SIZE];
+} traffic_history_t;
+
+static traffic_history_t History[MAX_TRACKING_OBJECTS];
+
+static void Traffic_History_Add(traffic_history_t *th, ufo_t *fop)
+{
+  if (th->addr != fop->addr) {
+    th->addr  = fop->addr;
+    th->count = 0;
+  }
+
+  if (th->count > 0 && th->timestamp[th->head] == fop->timestamp) {
+    return;
+  }
+
+  th->head = (th->head + 1) % TRAFFIC_HISTORY_SIZE;
+  th->timestamp[th->head] = fop->timestamp;
+  th->course[th->head]    = fop->course;
+  th->altitude[th->head]  = fop->altitude;
+
+  if (th->count < TRAFFIC_HISTORY_SIZE) {
+    th->count++;
+  }
+}
+
+/* turn rate (degrees per second, positive is clockwise) and climb (m/s) */
+static void Traffic_History_Rates(traffic_history_t *th, ufo_t *fop,
+                                  float *turn, float *climb)
+{
+  *turn  = 0;
+  *climb = fop->vs / (_GPS_FEET_PER_METER * 60.0);
+
+  if (th->addr == fop->addr && th->count > 1) {
+    uint8_t tail = (th->head + TRAFFIC_HISTORY_SIZE - th->count + 1) %
+                   TRAFFIC_HISTORY_SIZE;
+    float dt = (float) (th->timestamp[th->head] - th->timestamp[tail]);
+
+    if (dt > 0) {
+      float dc = th->course[th->head] - th->course[tail];
+
+      if (dc >  180.0) dc -= 360.0;
+      if (dc < -180.0) dc += 360.0;
+
+      *turn = constrain(dc / dt, -TURN_RATE_MAX, TURN_RATE_MAX);
+
+      if (fop->vs == 0) {
+        *climb = (th->altitude[th->head] - th->altitude[tail]) / dt;
+      }
+    }
+  }
+}
+
 /*
  * No any alarms issued by the firmware.
  * Rely upon high-level flight management software.
@@ -108,32 +210,989 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
 
 /*
  * "Legacy" method is based on short history of 2D velocity vectors (NS/EW)
+ *
+ * Both trajectories are projected over 4 segments (about 20 seconds),
+ * the target one along its own NS/EW vectors, this aircraft's one along
+ * its CoG and GS. The closest point of approach is searched segment by
+ * segment with integer math only: positions are in 0.25 m units,
+ * velocities in 0.25 m/s units, time in seconds.
  */
 static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
 {
+  int8_t rval = ALARM_LEVEL_NONE;
+  int32_t v_ns[4], v_ew[4];
+
+  /* Position of the target relative to this aircraft, own velocity */
+  int32_t p_ns = (int32_t) (fop->distance * 4 * cosf(radians(fop->bearing)));
+  int32_t p_ew = (int32_t) (fop->distance * 4 * sinf(radians(fop->bearing)));
+  int32_t p_z  = (int32_t) (fop->altitude - this_aircraft->altitude);
+
+  int32_t speed4 = (int32_t) (this_aircraft->speed * _GPS_MPS_PER_KNOT * 4);
+  int32_t own_ns = (int32_t) (speed4 * cosf(radians(this_aircraft->course)));
+  int32_t own_ew = (int32_t) (speed4 * sinf(radians(this_aircraft->course)));
+
+  /* vertical rates in 0.1 m/s */
+  int32_t v_z = (int32_t) ((fop->vs - this_aircraft->vs) * 10 /
+                           (_GPS_FEET_PER_METER * 60.0));
+
+  if (fop->ns[0] || fop->ew[0] || fop->ns[1] || fop->ew[1]) {
+    for (int i=0; i < 4; i++) {
+      v_ns[i] = (int32_t) fop->ns[i] << fop->smult;
+      v_ew[i] = (int32_t) fop->ew[i] << fop->smult;
+    }
+  } else {
+    /* no NS/EW data (non-legacy source) - use CoG and GS */
+    int32_t fo_speed4 = (int32_t) (fop->speed * _GPS_MPS_PER_KNOT * 4);
+    v_ns[0] = (int32_t) (fo_speed4 * cosf(radians(fop->course)));
+    v_ew[0] = (int32_t) (fo_speed4 * sinf(radians(fop->course)));
+    for (int i=1; i < 4; i++) {
+      v_ns[i] = v_ns[0];
+      v_ew[i] = v_ew[0];
+    }
+  }
+
+  const int64_t cpa_h2 = (int64_t) (LEGACY_CPA_HORIZONTAL * 4) * (LEGACY_CPA_HORIZONTAL * 4);
+
+  for (int i=0; i < 4; i++) {
+    int32_t vr_ns = v_ns[i] - own_ns;
+    int32_t vr_ew = v_ew[i] - own_ew;
+    int32_t t_cpa = 0;
+
+    int64_t v2 = (int64_t) vr_ns * vr_ns + (int64_t) vr_ew * vr_ew;
+
+    if (v2 > 0) {
+      int64_t pv = (int64_t) p_ns * vr_ns + (int64_t) p_ew * vr_ew;
+
+      /* time of closest approach within this segment */
+      t_cpa = (int32_t) constrain(-pv / v2, 0, LEGACY_NSEW_INTERVAL);
+    }
+
+    int64_t d_ns = p_ns + (int64_t) vr_ns * t_cpa;
+    int64_t d_ew = p_ew + (int64_t) vr_ew * t_cpa;
+    int32_t d_z  = p_z + (v_z * (i * LEGACY_NSEW_INTERVAL + t_cpa)) / 10;
+
+    if (d_ns * d_ns + d_ew * d_ew < cpa_h2 && abs(d_z) < LEGACY_CPA_VERTICAL) {
+      int32_t t = i * LEGACY_NSEW_INTERVAL + t_cpa;
+
+      /* time limit values are compliant with FLARM data port specs */
+      if (t < 9) {
+        rval = ALARM_LEVEL_URGENT;
+      } else if (t < 13) {
+        rval = ALARM_LEVEL_IMPORTANT;
+      } else if (t < 19) {
+        rval = ALARM_LEVEL_LOW;
+      }
+      break;
+    }
 
+    /* advance to the next segment */
+    p_ns += vr_ns * LEGACY_NSEW_INTERVAL;
+    p_ew += vr_ew * LEGACY_NSEW_INTERVAL;
+  }
+
+  return rval;
+}
+
+/*
+ * EXPERIMENTAL
+ *
+ * Turn-aware prediction. Both aircraft fly circular arcs with their
+ * current turn rates and climb rates, the relative track is stepped
+ * once a second over TURN_PREDICT_HORIZON.
+ * Velocity vectors are rotated by a precomputed matrix, so the cost per
+ * target is 8 trig calls plus about 20 multiplications and 20 additions
+ * per predicted second (roughly 450 float operations over 20 seconds).
+ */
+static int8_t Alarm_Turn(ufo_t *this_aircraft, ufo_t *fop)
+{
   int8_t rval = ALARM_LEVEL_NONE;
+  float own_turn, own_climb, fo_turn, fo_climb;
+
+  own_turn  = Track_TurnRate();
+  own_climb = Track_ClimbRate();
+  Traffic_History_Rates(&History[fop - Container], fop, &fo_turn, &fo_climb);
+
+  /* target position relative to this aircraft, metres */
+  float x = fop->distance * sinf(radians(fop->bearing));  /* east  */
+  float y = fop->distance * cosf(radians(fop->bearing));  /* north */
+  float z = fop->altitude - this_aircraft->altitude;
+
+  float own_v = this_aircraft->speed * _GPS_MPS_PER_KNOT;
+  float own_vx = own_v * sinf(radians(this_aircraft->course));
+  float own_vy = own_v * cosf(radians(this_aircraft->course));
+
+  float fo_v = fop->speed * _GPS_MPS_PER_KNOT;
+  float fo_vx = fo_v * sinf(radians(fop->course));
+  float fo_vy = fo_v * cosf(radians(fop->course));
+
+  /* clockwise rotation by one second worth of turn */
+  float own_c = cosf(radians(own_turn)), own_s = sinf(radians(own_turn));
+  float fo_c  = cosf(radians(fo_turn)),  fo_s  = sinf(radians(fo_turn));
+
+  for (int t = 1; t <= TURN_PREDICT_HORIZON; t++) {
+    float vx, vy;
+
+    x += fo_vx - own_vx;
+    y += fo_vy - own_vy;
+    z += fo_climb - own_climb;
+
+    if (x * x + y * y < (float) LEGACY_CPA_HORIZONTAL * LEGACY_CPA_HORIZONTAL &&
+        fabsf(z) < LEGACY_CPA_VERTICAL) {
+
+      /* time limit values are compliant with FLARM data port specs */
+      if (t < 9) {
+        rval = ALARM_LEVEL_URGENT;
+      } else if (t < 13) {
+        rval = ALARM_LEVEL_IMPORTANT;
+      } else if (t < 19) {
+        rval = ALARM_LEVEL_LOW;
+      }
+      break;
+    }
 
-  /* TBD */
+    vx = own_vx * own_c + own_vy * own_s;
+    vy = own_vy * own_c - own_vx * own_s;
+    own_vx = vx; own_vy = vy;
+
+    vx = fo_vx * fo_c + fo_vy * fo_s;
+    vy = fo_vy * fo_c - fo_vx * fo_s;
+    fo_vx = vx; fo_vy = vy;
+  }
 
   return rval;
 }
 
+/* scale factors of the local east-north frame, see ENU.h */
+static enu_anchor_t ENU_Anchor;
+
+static void Traffic_ENU_Anchor()
+{
+  ENU_Anchor_Update(&ENU_Anchor, ThisAircraft.latitude);
+}
+
+static int16_t Grid_Head[TRAFFIC_GRID_BUCKETS];
+static int16_t Grid_Next[MAX_TRACKING_OBJECTS];
+static int16_t Grid_X[MAX_TRACKING_OBJECTS];    /* cell of a slot */
+static int16_t Grid_Y[MAX_TRACKING_OBJECTS];
+static bool    Grid_Linked[MAX_TRACKING_OBJECTS];
+static int     Grid_Nx = 0;     /* cells around the globe, 0 - not laid out */
+static float   Grid_Dlon;       /* degrees per cell */
+static float   Grid_Dlat;
+static float   Grid_Latitude;   /* of the frame the cells were laid out in */
+
+static inline int Traffic_Grid_Bucket(int x, int y)
+{
+  return ((uint32_t) x * 73856093UL ^ (uint32_t) y * 19349663UL) &
+         (TRAFFIC_GRID_BUCKETS - 1);
+}
+
+/* column, wrapped around the antimeridian */
+static inline int Traffic_Grid_Wrap(int x)
+{
+  x %= Grid_Nx;
+  return x < 0 ? x + Grid_Nx : x;
+}
+
+static inline int Traffic_Grid_Column(float longitude)
+{
+  return (int) floorf((longitude + 180.0) / Grid_Dlon);
+}
+
+static inline int Traffic_Grid_Row(float latitude)
+{
+  return (int) floorf((latitude + 90.0) / Grid_Dlat);
+}
+
+static void Traffic_Grid_Unlink(int ndx)
+{
+  int16_t *pp = &Grid_Head[Traffic_Grid_Bucket(Grid_X[ndx], Grid_Y[ndx])];
+
+  while (*pp >= 0) {
+    if (*pp == ndx) {
+      *pp = Grid_Next[ndx];
+      break;
+    }
+    pp = &Grid_Next[*pp];
+  }
+  Grid_Linked[ndx] = false;
+}
+
+static void Traffic_Grid_Link(int ndx)
+{
+  int x = Traffic_Grid_Wrap(Traffic_Grid_Column(Container[ndx].longitude));
+  int y = Traffic_Grid_Row(Container[ndx].latitude);
+
+  if (Grid_Linked[ndx]) {
+    if (Grid_X[ndx] == x && Grid_Y[ndx] == y) {
+      return;
+    }
+    Traffic_Grid_Unlink(ndx);
+  }
+
+  int b = Traffic_Grid_Bucket(x, y);
+
+  Grid_X[ndx]      = x;
+  Grid_Y[ndx]      = y;
+  Grid_Next[ndx]   = Grid_Head[b];
+  Grid_Head[b]     = ndx;
+  Grid_Linked[ndx] = true;
+}
+
+/* cells are as wide in metres as the frame of own-ship says */
+static void Traffic_Grid_Prepare()
+{
+  Traffic_ENU_Anchor();
+
+  if (Grid_Nx > 0 && Grid_Latitude == ENU_Anchor.latitude) {
+    return;
+  }
+
+  Grid_Nx       = (int) (360.0 * ENU_Anchor.m_per_deg_lon / TRAFFIC_GRID_CELL);
+  Grid_Nx       = Grid_Nx < 1 ? 1 : Grid_Nx;
+  Grid_Dlon     = 360.0 / Grid_Nx;
+  Grid_Dlat     = TRAFFIC_GRID_CELL / ENU_Anchor.m_per_deg_lat;
+  Grid_Latitude = ENU_Anchor.latitude;
+
+  for (int b=0; b < TRAFFIC_GRID_BUCKETS; b++) {
+    Grid_Head[b] = -1;
+  }
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    Grid_Linked[i] = false;
+    if (Container[i].addr) {
+      Traffic_Grid_Link(i);
+    }
+  }
+}
+
+/* re-bucket Container[ndx] once it has moved into another cell */
+static void Traffic_Grid_Update(int ndx)
+{
+  Traffic_Grid_Prepare();
+  Traffic_Grid_Link(ndx);
+}
+
+static int Traffic_Slot_Compare(const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/*
+ * Slots within a box around (latitude, longitude), offsets in metres
+ * as west, south, east, north. Only the cells overlapping the box are
+ * visited; the slots come out in slot order, as a scan would give them.
+ */
+static int Traffic_Grid_Query(float latitude, float longitude, const float *box,
+                              int *slots, int max)
+{
+  int n = 0;
+
+  Traffic_Grid_Prepare();
+
+  int x0 = Traffic_Grid_Column(longitude + box[0] / ENU_Anchor.m_per_deg_lon);
+  int x1 = Traffic_Grid_Column(longitude + box[2] / ENU_Anchor.m_per_deg_lon);
+  int y0 = Traffic_Grid_Row(latitude + box[1] / ENU_Anchor.m_per_deg_lat);
+  int y1 = Traffic_Grid_Row(latitude + box[3] / ENU_Anchor.m_per_deg_lat);
+
+  if (x1 - x0 + 1 >= Grid_Nx) {
+    x0 = 0;
+    x1 = Grid_Nx - 1;
+  }
+
+  bool every_cell = ((x1 - x0 + 1) * (y1 - y0 + 1) >= TRAFFIC_GRID_BUCKETS);
+  int cells = every_cell ? 1 : (x1 - x0 + 1) * (y1 - y0 + 1);
+
+  for (int c=0; c < cells && n < max; c++) {
+    int x = Traffic_Grid_Wrap(x0 + c % (x1 - x0 + 1));
+    int y = y0 + c / (x1 - x0 + 1);
+    int i = every_cell ? 0 : Grid_Head[Traffic_Grid_Bucket(x, y)];
+
+    for (; i >= 0 && i < MAX_TRACKING_OBJECTS && n < max;
+         i = every_cell ? i + 1 : Grid_Next[i]) {
+      if (!Container[i].addr ||
+          (!every_cell && (Grid_X[i] != x || Grid_Y[i] != y))) {
+        continue;
+      }
+
+      float dlon = Container[i].longitude - longitude;
+
+      if (dlon >  180.0) dlon -= 360.0;
+      if (dlon < -180.0) dlon += 360.0;
+
+      float de = dlon * ENU_Anchor.m_per_deg_lon;
+      float dn = (Container[i].latitude - latitude) * ENU_Anchor.m_per_deg_lat;
+
+      if (de >= box[0] && dn >= box[1] && de <= box[2] && dn <= box[3]) {
+        slots[n++] = i;
+      }
+    }
+  }
+
+  qsort(slots, n, sizeof(int), Traffic_Slot_Compare);
+
+  return n;
+}
+
+/*
+ * Slots of the aircraft within a box around own-ship, offsets in metres.
+ * Returns the number of slots stored, at most max.
+ */
+int Traffic_Query_Box(float west, float south, float east, float north,
+                      int *slots, int max)
+{
+  const float box[4] = { west, south, east, north };
+
+  return Traffic_Grid_Query(ThisAircraft.latitude, ThisAircraft.longitude,
+                            box, slots, max);
+}
+
+/*
+ * Slots of the aircraft closer to own-ship than radius (metres),
+ * and within vertical (metres) of its altitude unless vertical is 0.
+ */
+int Traffic_Query_Radius(float radius, float vertical, int *slots, int max)
+{
+  int n = Traffic_Query_Box(-radius, -radius, radius, radius, slots, max);
+  int m = 0;
+
+  for (int k=0; k < n; k++) {
+    ufo_t *fop = &Container[slots[k]];
+
+    if (fop->distance < radius &&
+        (vertical == 0 || fabsf(fop->altitude - ThisAircraft.altitude) < vertical)) {
+      slots[m++] = slots[k];
+    }
+  }
+
+  return m;
+}
+
+static void Traffic_ENU(float lat, float lon, float *east, float *north)
+{
+  ENU_Project(&ENU_Anchor, ThisAircraft.latitude, ThisAircraft.longitude,
+              lat, lon, east, north);
+}
+
+/*
+ * A new packet of Container[ndx] has arrived. The position residual against
+ * the dead-reckoned one corrects position and velocity, reported course and
+ * speed are blended in. Costs 4 trig calls and about 40 float operations.
+ */
+static void Traffic_Track_Measure(int ndx)
+{
+  ufo_t *fop = &Container[ndx];
+  traffic_track_t *tp = &Tracker[ndx];
+  unsigned long ms = millis();
+
+  float v  = fop->speed * _GPS_MPS_PER_KNOT;
+  float vn = v * cosf(radians(fop->course));
+  float ve = v * sinf(radians(fop->course));
+
+  /* a new aircraft, or one back after its entry expired, starts over */
+  if (tp->addr != fop->addr ||
+      ms - tp->ms > ENTRY_EXPIRATION_TIME * 1000UL) {
+    tp->addr      = fop->addr;
+    tp->ms        = ms;
+    tp->latitude  = fop->latitude;
+    tp->longitude = fop->longitude;
+    tp->vn        = vn;
+    tp->ve        = ve;
+    return;
+  }
+
+  Traffic_ENU_Anchor();
+
+  float dt = (ms - tp->ms) / 1000.0;
+
+  /* residual of the measurement against the prediction, metres */
+  float rn = (fop->latitude - tp->latitude) * ENU_Anchor.m_per_deg_lat -
+             tp->vn * dt;
+  float re = (fop->longitude - tp->longitude) * ENU_Anchor.m_per_deg_lon -
+             tp->ve * dt;
+
+  tp->latitude  += (tp->vn * dt + TRACK_ALPHA * rn) / ENU_Anchor.m_per_deg_lat;
+  tp->longitude += (tp->ve * dt + TRACK_ALPHA * re) / ENU_Anchor.m_per_deg_lon;
+
+  if (dt > 0.1) {
+    tp->vn += TRACK_BETA * rn / dt;
+    tp->ve += TRACK_BETA * re / dt;
+  }
+
+  tp->vn += TRACK_GAMMA * (vn - tp->vn);
+  tp->ve += TRACK_GAMMA * (ve - tp->ve);
+  tp->ms  = ms;
+
+  fop->latitude  = tp->latitude;
+  fop->longitude = tp->longitude;
+
+  v = sqrtf(tp->vn * tp->vn + tp->ve * tp->ve);
+  if (v > TRACK_MIN_SPEED) {
+    float course = degrees(atan2f(tp->ve, tp->vn));
+    fop->course  = course < 0 ? course + 360.0 : course;
+  }
+  fop->speed = v / _GPS_MPS_PER_KNOT;
+}
+
+/* dead-reckon Container[ndx] to this moment, 6 float operations */
+static void Traffic_Track_Predict(int ndx)
+{
+  ufo_t *fop = &Container[ndx];
+  traffic_track_t *tp = &Tracker[ndx];
+
+  if (tp->addr != fop->addr) {
+    return;
+  }
+
+  float dt = (millis() - tp->ms) / 1000.0;
+
+  fop->latitude  = tp->latitude  + tp->vn * dt / ENU_Anchor.m_per_deg_lat;
+  fop->longitude = tp->longitude + tp->ve * dt / ENU_Anchor.m_per_deg_lon;
+  fop->coasting  = dt > TRACK_COAST_TIME;
+}
+
+/* seconds until the closest approach, east and north are the target offsets */
+static float Traffic_TimeToCPA(float east, float north, ufo_t *fop)
+{
+  float own_v = ThisAircraft.speed * _GPS_MPS_PER_KNOT;
+  float fo_v  = fop->speed * _GPS_MPS_PER_KNOT;
+
+  float ve = fo_v  * sinf(radians(fop->course)) -
+             own_v * sinf(radians(ThisAircraft.course));
+  float vn = fo_v  * cosf(radians(fop->course)) -
+             own_v * cosf(radians(ThisAircraft.course));
+  float v2 = ve * ve + vn * vn;
+  float closing = -(east * ve + north * vn);
+
+  if (v2 > 0 && closing > 0 && closing < v2 * TRAFFIC_TCPA_NONE) {
+    return closing / v2;
+  }
+
+  return TRAFFIC_TCPA_NONE;
+}
+
+static bool Traffic_Rank_Before(int a, int b)
+{
+  if (Container[a].alarm_level != Container[b].alarm_level) {
+    return Container[a].alarm_level > Container[b].alarm_level;
+  }
+  if ((int) Traffic_TCPA[a] != (int) Traffic_TCPA[b]) {
+    return Traffic_TCPA[a] < Traffic_TCPA[b];
+  }
+  return Container[a].distance < Container[b].distance;
+}
+
+/*
+ * Re-position Container[ndx] in Traffic_Ranking[]. An empty slot is just
+ * removed. Costs one pass over the ranking.
+ */
+void Traffic_Rank(int ndx)
+{
+  int i;
+
+  for (i=0; Traffic_In_Ranking[ndx] && i < Traffic_Ranked; i++) {
+    if (Traffic_Ranking[i] == ndx) {
+      memmove(&Traffic_Ranking[i], &Traffic_Ranking[i+1],
+              (Traffic_Ranked - i - 1) * sizeof(Traffic_Ranking[0]));
+      Traffic_Ranked--;
+      break;
+    }
+  }
+  Traffic_In_Ranking[ndx] = false;
+
+  if (!Container[ndx].addr) {
+    return;
+  }
+
+  for (i = Traffic_Ranked; i > 0 && Traffic_Rank_Before(ndx, Traffic_Ranking[i-1]); i--) {
+    Traffic_Ranking[i] = Traffic_Ranking[i-1];
+  }
+  Traffic_Ranking[i] = ndx;
+  Traffic_Ranked++;
+  Traffic_In_Ranking[ndx] = true;
+}
+
+/*
+ * Bring Traffic_Ranking[] back in order after a step of dead reckoning
+ * of the count slots given. Empty slots are dropped, slots given that are
+ * not ranked yet appended, then one insertion pass moves the entries
+ * marked in Traffic_Rank_Changed[]. Two neighbours that are both unchanged are in order already, so
+ * the pass costs one comparison per changed entry plus its moves.
+ */
+static void Traffic_Rerank(const uint16_t *slots, int count)
+{
+  int n = 0;
+
+  for (int r=0; r < Traffic_Ranked; r++) {
+    int i = Traffic_Ranking[r];
+
+    if (Container[i].addr) {
+      Traffic_Ranking[n++] = i;
+    } else {
+      Traffic_In_Ranking[i] = false;
+    }
+  }
+  for (int j=0; j < count; j++) {
+    int i = slots[j];
+
+    if (Container[i].addr && !Traffic_In_Ranking[i]) {
+      Traffic_Ranking[n++]    = i;
+      Traffic_In_Ranking[i]   = true;
+      Traffic_Rank_Changed[i] = true;
+    }
+  }
+  Traffic_Ranked = n;
+
+  for (int r=1; r < n; r++) {
+    int i = Traffic_Ranking[r];
+    int k = r;
+
+    if (!Traffic_Rank_Changed[i] && !Traffic_Rank_Changed[Traffic_Ranking[r-1]]) {
+      continue;
+    }
+    for (; k > 0 && Traffic_Rank_Before(i, Traffic_Ranking[k-1]); k--) {
+      Traffic_Ranking[k] = Traffic_Ranking[k-1];
+    }
+    Traffic_Ranking[k] = i;
+  }
+
+  for (int r=0; r < n; r++) {
+    Traffic_Rank_Changed[Traffic_Ranking[r]] = false;
+  }
+}
+
 void Traffic_Update(int ndx)
 {
-  Container[ndx].distance = gnss.distanceBetween( ThisAircraft.latitude,
-                                                  ThisAircraft.longitude,
-                                                  Container[ndx].latitude,
-                                                  Container[ndx].longitude);
+  float east, north;
+
+  Traffic_Track_Measure(ndx);
+  Traffic_Grid_Update(ndx);
 
-  Container[ndx].bearing = gnss.courseTo( ThisAircraft.latitude,
-                                          ThisAircraft.longitude,
-                                          Container[ndx].latitude,
-                                          Container[ndx].longitude);
+  Traffic_ENU(Container[ndx].latitude, Container[ndx].longitude, &east, &north);
+
+  Container[ndx].distance = sqrtf(east * east + north * north);
+
+  float bearing = degrees(atan2f(east, north));
+  Container[ndx].bearing = bearing < 0 ? bearing + 360.0 : bearing;
+
+  if (Alarm_Level == &Alarm_Turn) {
+    Traffic_History_Add(&History[ndx], &Container[ndx]);
+  }
 
   if (Alarm_Level) {
     Container[ndx].alarm_level = (*Alarm_Level)(&ThisAircraft, &Container[ndx]);
   }
+
+  Traffic_TCPA[ndx] = Traffic_TimeToCPA(east, north, &Container[ndx]);
+  Traffic_Rank(ndx);
+}
+
+/*
+ * Relative geometry of every target in hot, and the distance alarm
+ * when that is the method in use
+ */
+void Traffic_Geometry(traffic_hot_t *hot)
+{
+  int n = hot->count;
+
+  Traffic_ENU_Anchor();
+
+  const float k_lat = ENU_Anchor.m_per_deg_lat;
+  const float k_lon = ENU_Anchor.m_per_deg_lon;
+  const float k_tan = radians(ENU_Anchor.tan_lat);
+  const float lat_o = ThisAircraft.latitude - ENU_Anchor.latitude;
+
+  for (int j=0; j < n; j++) {
+    float north = hot->dlat[j] * k_lat;
+    float east  = hot->dlon[j] * k_lon *
+                  (1.0f - k_tan * (lat_o + hot->dlat[j] * 0.5f));
+
+    hot->north[j]    = north;
+    hot->east[j]     = east;
+    hot->distance[j] = sqrtf(east * east + north * north);
+  }
+
+  for (int j=0; j < n; j++) {
+    float bearing = degrees(atan2f(hot->east[j], hot->north[j]));
+    hot->bearing[j] = bearing < 0 ? bearing + 360.0f : bearing;
+  }
+
+  if (Alarm_Level == &Alarm_Distance) {
+    for (int j=0; j < n; j++) {
+      float d = hot->distance[j];
+
+      hot->alarm_level[j] =
+        fabsf(hot->dalt[j]) >= VERTICAL_SEPARATION ? ALARM_LEVEL_NONE  :
+        d < ALARM_ZONE_URGENT                      ? ALARM_LEVEL_URGENT :
+        d < ALARM_ZONE_IMPORTANT                   ? ALARM_LEVEL_IMPORTANT :
+        d < ALARM_ZONE_LOW                         ? ALARM_LEVEL_LOW :
+                                                     ALARM_LEVEL_NONE;
+    }
+  }
+}
+
+/*
+ * Hot fields of all active targets. Container[] remains the canonical
+ * (cold) store of the aircraft data, the arrays below are gathered from it
+ * and scattered back.
+ */
+static uint16_t Traffic_Hot_Index[MAX_TRACKING_OBJECTS]; /* Container[] slot */
+static float   Traffic_Hot_Dlat[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_Dlon[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_Dalt[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_North[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_East[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_Distance[MAX_TRACKING_OBJECTS];
+static float   Traffic_Hot_Bearing[MAX_TRACKING_OBJECTS];
+static int8_t  Traffic_Hot_Alarm[MAX_TRACKING_OBJECTS];
+
+static traffic_hot_t Traffic_Hot = {
+  0,
+  Traffic_Hot_Dlat, Traffic_Hot_Dlon, Traffic_Hot_Dalt,
+  Traffic_Hot_North, Traffic_Hot_East,
+  Traffic_Hot_Distance, Traffic_Hot_Bearing, Traffic_Hot_Alarm
+};
+
+void Traffic_UpdateAll()
+{
+  int n = 0;
+
+  Traffic_ENU_Anchor();
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr) {
+      Traffic_Track_Predict(i);
+      Traffic_Grid_Update(i);
+
+      float dlon = Container[i].longitude - ThisAircraft.longitude;
+
+      if (dlon >  180.0) dlon -= 360.0;
+      if (dlon < -180.0) dlon += 360.0;
+
+      Traffic_Hot_Index[n] = i;
+      Traffic_Hot.dlat[n]  = Container[i].latitude - ThisAircraft.latitude;
+      Traffic_Hot.dlon[n]  = dlon;
+      Traffic_Hot.dalt[n]  = Container[i].altitude - ThisAircraft.altitude;
+      n++;
+    }
+  }
+  Traffic_Hot.count = n;
+
+  Traffic_Geometry(&Traffic_Hot);
+
+  for (int j=0; j < n; j++) {
+    int i = Traffic_Hot_Index[j];
+    ufo_t *fop = &Container[i];
+    int8_t alarm_level = fop->alarm_level;
+    float distance = fop->distance;
+    int tcpa = (int) Traffic_TCPA[i];
+
+    fop->distance = Traffic_Hot.distance[j];
+    fop->bearing  = Traffic_Hot.bearing[j];
+
+    if (Alarm_Level == &Alarm_Distance) {
+      fop->alarm_level = Traffic_Hot.alarm_level[j];
+    } else if (Alarm_Level) {
+      /* vector predictors keep their per target state */
+      if (Alarm_Level == &Alarm_Turn) {
+        Traffic_History_Add(&History[i], fop);
+      }
+      fop->alarm_level = (*Alarm_Level)(&ThisAircraft, fop);
+    }
+
+    Traffic_TCPA[i] =
+      Traffic_TimeToCPA(Traffic_Hot.east[j], Traffic_Hot.north[j], fop);
+
+    Traffic_Rank_Changed[i] = fop->alarm_level != alarm_level ||
+                              (int) Traffic_TCPA[i] != tcpa ||
+                              fop->distance != distance;
+  }
+
+  Traffic_Rerank(Traffic_Hot_Index, n);
+}
+
+/* the higher, the better source of a field */
+static uint8_t Traffic_Source_Rank(uint8_t field, uint8_t protocol)
+{
+  bool adsb = (protocol == RF_PROTOCOL_ADSB_1090 ||
+               protocol == RF_PROTOCOL_ADSB_UAT);
+
+  switch (field)
+  {
+  case TRAFFIC_FIELD_ALTITUDE:
+    return adsb ? 0 : 1;  /* ADS-B 'altitude' is a baro one */
+  case TRAFFIC_FIELD_BARO:
+    return adsb ? 1 : 0;
+  case TRAFFIC_FIELD_CLIMB:
+    return protocol == RF_PROTOCOL_LEGACY ? 1 : 0;
+  case TRAFFIC_FIELD_POSITION:
+  default:
+    return 0;             /* the most recent one */
+  }
+}
+
+/* fuse fop into the track of Container[ndx], fop takes the result */
+static void Traffic_Fuse(int ndx, ufo_t *fop)
+{
+  ufo_t *cp = &Container[ndx];
+  traffic_fusion_t *tf = &Traffic_Fusion[ndx];
+  float *value[TRAFFIC_FIELD_COUNT] = {
+    NULL, &fop->altitude, &fop->pressure_altitude, &fop->vs
+  };
+  float *prev[TRAFFIC_FIELD_COUNT] = {
+    NULL, &cp->altitude, &cp->pressure_altitude, &cp->vs
+  };
+
+  for (int f=0; f < TRAFFIC_FIELD_COUNT; f++) {
+    bool keep = value[f] &&
+                (fop->timestamp - tf->time[f]) <= TRAFFIC_FUSION_HOLD &&
+                (Traffic_Source_Rank(f, tf->source[f]) >
+                   Traffic_Source_Rank(f, fop->protocol) ||
+                 (f == TRAFFIC_FIELD_BARO && fop->pressure_altitude == 0.0));
+
+    if (keep) {
+      *value[f] = *prev[f];
+    } else {
+      tf->source[f] = fop->protocol;
+      tf->time[f]   = fop->timestamp;
+    }
+  }
+
+  /* keep identity of the track stable for the tracker and the exports */
+  if (fop->protocol != cp->protocol || fop->addr != cp->addr) {
+    if (strnlen((char *) fop->callsign, sizeof(fop->callsign)) == 0) {
+      memcpy(fop->callsign, cp->callsign, sizeof(fop->callsign));
+    }
+    fop->addr      = cp->addr;
+    fop->addr_type = cp->addr_type;
+    fop->protocol  = cp->protocol;
+  }
+}
+
+/* fop and the track of Container[ndx] are where one aircraft could be */
+static bool Traffic_Gate(int ndx, ufo_t *fop)
+{
+  ufo_t *cp = &Container[ndx];
+
+  if (fop->timestamp - cp->timestamp > TRAFFIC_FUSION_HOLD) {
+    return false;
+  }
+
+  Traffic_ENU_Anchor();
+
+  float dlon = fop->longitude - cp->longitude;
+
+  if (dlon >  180.0) dlon -= 360.0;
+  if (dlon < -180.0) dlon += 360.0;
+
+  float dn = (fop->latitude - cp->latitude) * ENU_Anchor.m_per_deg_lat;
+  float de = dlon * ENU_Anchor.m_per_deg_lon;
+
+  if (dn * dn + de * de >= (float) TRAFFIC_FUSION_GATE_H * TRAFFIC_FUSION_GATE_H ||
+      fabsf(fop->altitude - cp->altitude) >= TRAFFIC_FUSION_GATE_V) {
+    return false;
+  }
+
+  float fo_v = fop->speed * _GPS_MPS_PER_KNOT;
+  float cp_v = cp->speed  * _GPS_MPS_PER_KNOT;
+
+  if (fabsf(fo_v - cp_v) >= TRAFFIC_FUSION_GATE_SPEED) {
+    return false;
+  }
+
+  if (fo_v > TRAFFIC_FUSION_MIN_SPEED && cp_v > TRAFFIC_FUSION_MIN_SPEED) {
+    float dtrack = fabsf(fop->course - cp->course);
+
+    if (dtrack > 180) {
+      dtrack = 360 - dtrack;
+    }
+    if (dtrack >= TRAFFIC_FUSION_GATE_TRACK) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Empty Container[ndx] together with the track state kept alongside it,
+ * so that an aircraft coming back into the slot does not pick up
+ * its old velocity or history
+ */
+void Traffic_Clear(int ndx)
+{
+  if (Grid_Linked[ndx]) {
+    Traffic_Grid_Unlink(ndx);
+  }
+  Container[ndx] = EmptyFO;
+  memset(&Tracker[ndx], 0, sizeof(traffic_track_t));
+  memset(&History[ndx], 0, sizeof(traffic_history_t));
+  for (int s=0; s < EXPORT_SINK_COUNT; s++) {
+    memset(&ExportSnapshot[s][ndx], 0, sizeof(export_snapshot_t));
+  }
+  Traffic_Rank(ndx);
+}
+
+/*
+ * Put a received aircraft into Container[]: update its own track, the track
+ * of the same aircraft heard over another protocol, or take a free or
+ * expired slot. Returns the slot, or -1 when the table is full.
+ */
+int Traffic_Add(ufo_t *fop)
+{
+  int ndx = -1;
+  int own = -1;
+  int alias = -1;
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    ufo_t *cp = &Container[i];
+
+    if (!cp->addr) {
+      continue;
+    }
+    if (cp->addr == fop->addr &&
+        (cp->protocol == fop->protocol ||
+         (cp->addr_type == ADDR_TYPE_ICAO && fop->addr_type == ADDR_TYPE_ICAO))) {
+      own = own < 0 ? i : own;
+    } else if (Traffic_Fusion[i].alias == fop->addr &&
+               Traffic_Fusion[i].alias_protocol == fop->protocol) {
+      alias = alias < 0 ? i : alias;
+    }
+  }
+
+  /* an alias is fused only as long as both tracks keep agreeing */
+  if (alias >= 0) {
+    traffic_fusion_t *tf = &Traffic_Fusion[alias];
+
+    if (Traffic_Gate(alias, fop)) {
+      if (tf->alias_hits < TRAFFIC_FUSION_CONFIRM) {
+        tf->alias_hits++;
+      }
+      if (tf->alias_hits >= TRAFFIC_FUSION_CONFIRM) {
+        tf->fused = true;
+        ndx = alias;
+
+        /* the alias' own track is this one from now on */
+        if (own >= 0) {
+          Traffic_Clear(own);
+          own = -1;
+        }
+      }
+    } else {
+      memset(tf, 0, sizeof(traffic_fusion_t));
+      for (int f=0; f < TRAFFIC_FIELD_COUNT; f++) {
+        tf->source[f] = Container[alias].protocol;
+        tf->time[f]   = Container[alias].timestamp;
+      }
+      alias = -1;
+    }
+  }
+
+  if (ndx < 0) {
+    ndx = own;
+  }
+
+  /* spatio-temporal gating against the tracks of other protocols */
+  if (alias < 0) {
+    const float gate[4] = { -TRAFFIC_FUSION_GATE_H, -TRAFFIC_FUSION_GATE_H,
+                             TRAFFIC_FUSION_GATE_H,  TRAFFIC_FUSION_GATE_H };
+    int near[MAX_TRACKING_OBJECTS];
+    int count = Traffic_Grid_Query(fop->latitude, fop->longitude, gate,
+                                   near, MAX_TRACKING_OBJECTS);
+
+    for (int k=0; k < count; k++) {
+      int i = near[k];
+      ufo_t *cp = &Container[i];
+
+      if (!cp->addr || i == own || cp->protocol == fop->protocol ||
+          Traffic_Fusion[i].alias || !Traffic_Gate(i, fop)) {
+        continue;
+      }
+      /* the pair is on its way to fusion the other way round */
+      if (own >= 0 && Traffic_Fusion[own].alias == cp->addr &&
+          Traffic_Fusion[own].alias_protocol == cp->protocol) {
+        break;
+      }
+
+      Traffic_Fusion[i].alias          = fop->addr;
+      Traffic_Fusion[i].alias_protocol = fop->protocol;
+      Traffic_Fusion[i].alias_hits     = 1;
+      break;
+    }
+  }
+
+  if (ndx >= 0) {
+    Traffic_Fuse(ndx, fop);
+  } else {
+    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+      if (!Container[i].addr) {
+        ndx = i;
+        break;
+      }
+      if (fop->timestamp - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
+        METRIC_INC(traffic_evictions);
+        Traffic_Clear(i);
+        ndx = i;
+        break;
+      }
+    }
+
+    if (ndx < 0) {
+      METRIC_INC(traffic_dropped);
+      return -1;
+    }
+
+    memset(&Traffic_Fusion[ndx], 0, sizeof(traffic_fusion_t));
+    for (int f=0; f < TRAFFIC_FIELD_COUNT; f++) {
+      Traffic_Fusion[ndx].source[f] = fop->protocol;
+      Traffic_Fusion[ndx].time[f]   = fop->timestamp;
+    }
+  }
+
+  Container[ndx] = *fop;
+  Traffic_Update(ndx);
+
+  return ndx;
+}
+
+/*
+ * Returns true when Container[ndx] has to be (re-)sent to the export sink.
+ * Always true unless delta export is enabled in the settings.
+ */
+bool Traffic_NeedsExport(int ndx, uint8_t sink)
+{
+  ufo_t *fop = &Container[ndx];
+  export_snapshot_t *snap = &ExportSnapshot[sink][ndx];
+
+  if (settings->export_delta && snap->addr == fop->addr &&
+      millis() - snap->timestamp < EXPORT_DELTA_REFRESH_MS) {
+
+    float dlat = (fop->latitude  - snap->latitude)  * 111320.0;
+    float dlon = (fop->longitude - snap->longitude) * 111320.0 *
+                 cosf(radians(fop->latitude));
+    float dcourse = fabs(fop->course - snap->course);
+
+    if (dcourse > 180.0) {
+      dcourse = 360.0 - dcourse;
+    }
+
+    if (dlat * dlat + dlon * dlon < EXPORT_DELTA_DIST * EXPORT_DELTA_DIST &&
+        fabs(fop->altitude - snap->altitude) < EXPORT_DELTA_ALT           &&
+        dcourse < EXPORT_DELTA_COURSE                                      &&
+        fabs(fop->speed - snap->speed) < EXPORT_DELTA_SPEED                &&
+        fop->alarm_level == snap->alarm_level) {
+      return false;
+    }
+  }
+
+  snap->addr        = fop->addr;
+  snap->latitude    = fop->latitude;
+  snap->longitude   = fop->longitude;
+  snap->altitude    = fop->altitude;
+  snap->course      = fop->course;
+  snap->speed       = fop->speed;
+  snap->alarm_level = fop->alarm_level;
+  snap->timestamp   = millis();
+
+  return true;
 }
 
 void ParseData()
@@ -148,31 +1207,43 @@ void ParseData()
     memset(fo.raw, 0, sizeof(fo.raw));
     memcpy(fo.raw, RxBuffer, rx_size);
 
-    if (settings->nmea_p) {
-      StdOut.print(F("$PSRFI,"));
-      StdOut.print((unsigned long) now()); StdOut.print(F(","));
-      StdOut.print(Bin2Hex(fo.raw, rx_size)); StdOut.print(F(","));
-      StdOut.println(RF_last_rssi);
-    }
+    int ndx = -1;
 
     if (protocol_decode && (*protocol_decode)((void *) RxBuffer, &ThisAircraft, &fo)) {
 
       fo.rssi = RF_last_rssi;
+      fo.rx_us = RF_rx_us;
+      Latency_Add(LATENCY_DECODE, micros() - fo.rx_us);
 
-      for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-
-        if (Container[i].addr == fo.addr) {
-          Container[i] = fo;
-          Traffic_Update(i);
-          break;
-        } else {
-          if (now() - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[i] = fo;
-            Traffic_Update(i);
-            break;
-          }
-        }
+      ndx = Traffic_Add(&fo);
+
+      if (ndx >= 0) {
+        Latency_Add(LATENCY_TRAFFIC, micros() - fo.rx_us);
+        Link_Add(ndx, &fo, RF_last_errors);
+      }
+    } else {
+      METRIC_INC_PROTOCOL(rx_decode_errors, settings->rf_protocol);
+    }
+
+    /*
+     * time, packet, RSSI, errors corrected; then, for a packet that made
+     * it into the traffic table: address, smoothed RSSI, packets per minute
+     * and loss (%) of the aircraft
+     */
+    if (settings->nmea_p) {
+      StdOut.print(F("$PSRFI,"));
+      StdOut.print((unsigned long) now()); StdOut.print(F(","));
+      StdOut.print(Bin2Hex(fo.raw, rx_size)); StdOut.print(F(","));
+      StdOut.print(RF_last_rssi); StdOut.print(F(","));
+      StdOut.print(RF_last_errors);
+      if (ndx >= 0) {
+        StdOut.print(F(","));
+        StdOut.print(Container[ndx].addr, HEX); StdOut.print(F(","));
+        StdOut.print(Link_Rssi(ndx)); StdOut.print(F(","));
+        StdOut.print(Link_Rate(ndx)); StdOut.print(F(","));
+        StdOut.print(Link_Loss(ndx));
       }
+      StdOut.println();
     }
 }
 
@@ -189,6 +1260,9 @@ void Traffic_setup()
   case TRAFFIC_ALARM_LEGACY:
     Alarm_Level = &Alarm_Legacy;
     break;
+  case TRAFFIC_ALARM_TURN:
+    Alarm_Level = &Alarm_Turn;
+    break;
   case TRAFFIC_ALARM_DISTANCE:
   default:
     Alarm_Level = &Alarm_Distance;
@@ -201,15 +1275,15 @@ void Traffic_loop()
   if (isTimeToUpdateTraffic()) {
     for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
 
-      if (Container[i].addr &&
-          (ThisAircraft.timestamp - Container[i].timestamp) <= ENTRY_EXPIRATION_TIME) {
-        if ((ThisAircraft.timestamp - Container[i].timestamp) >= TRAFFIC_VECTOR_UPDATE_INTERVAL)
-          Traffic_Update(i);
-      } else {
+      if (!Container[i].addr) {
         Container[i] = EmptyFO;
+      } else if ((ThisAircraft.timestamp - Container[i].timestamp) > ENTRY_EXPIRATION_TIME) {
+        Traffic_Clear(i);
       }
     }
 
+    Traffic_UpdateAll();
+
     UpdateTrafficTimeMarker = millis();
   }
 }
@@ -218,7 +1292,7 @@ void ClearExpired()
 {
   for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
     if (Container[i].addr && (ThisAircraft.timestamp - Container[i].timestamp) > ENTRY_EXPIRATION_TIME) {
-      Container[i] = EmptyFO;
+      Traffic_Clear(i);
     }
   }
 }
@@ -22,6 +22,8 @@
 #include "SoftRF.h"
 #include "SoCHelper.h"
 
+#include <ENU.h>
+
 #define ALARM_ZONE_NONE       10000 /* zone range is 1000m <-> 10000m */
 #define ALARM_ZONE_LOW        1000  /* zone range is  700m <->  1000m */
 #define ALARM_ZONE_IMPORTANT  700   /* zone range is  400m <->   700m */
@@ -30,17 +32,147 @@
 #define VERTICAL_SEPARATION         300 /* metres */
 #define VERTICAL_VISIBILITY_RANGE   500 /* value from FLARM data port specs */
 
-#define TRAFFIC_VECTOR_UPDATE_INTERVAL 2 /* seconds */
-#define TRAFFIC_UPDATE_INTERVAL_MS (TRAFFIC_VECTOR_UPDATE_INTERVAL * 1000)
+/*
+ * "Legacy" predictor: NS/EW velocity vectors are taken as consecutive
+ * segments of the flight path, LEGACY_NSEW_INTERVAL seconds each
+ */
+#define LEGACY_NSEW_INTERVAL        5   /* seconds */
+#define LEGACY_CPA_HORIZONTAL       200 /* metres */
+#define LEGACY_CPA_VERTICAL         100 /* metres */
+
+/*
+ * Turn-aware predictor: turn rate and climb are estimated over a short
+ * history of every aircraft, trajectories are projected as circular arcs
+ */
+#define TRAFFIC_HISTORY_SIZE        4   /* samples, 1 per second at most */
+#define TURN_PREDICT_HORIZON        20  /* seconds */
+#define TURN_RATE_MAX               30  /* degrees per second */
+
+/*
+ * Traffic_Ranking[] keeps Container[] slots ordered by relevance: alarm level,
+ * then time to closest approach, then distance. Every update re-positions
+ * a single slot, so that the consumers never have to sort.
+ */
+#define TRAFFIC_TCPA_NONE           3600 /* seconds, not closing in */
+
+/*
+ * Alpha-beta tracker: received positions are smoothed, and in between
+ * packets targets are dead-reckoned every TRAFFIC_UPDATE_INTERVAL_MS
+ */
+#define TRACK_ALPHA                 0.5 /* position gain */
+#define TRACK_BETA                  0.2 /* velocity gain */
+#define TRACK_GAMMA                 0.5 /* weight of reported course and speed */
+#define TRACK_COAST_TIME            2   /* seconds without a packet */
+#define TRACK_MIN_SPEED             1.0 /* m/s, keep reported course below */
+
+#define TRAFFIC_UPDATE_INTERVAL_MS  200
+
+/*
+ * Spatial grid of the traffic: the globe is cut into cells about
+ * TRAFFIC_GRID_CELL wide, hashed into TRAFFIC_GRID_BUCKETS lists of slots.
+ * A cell is twice the export range, so that a query of 10 to 20 km around
+ * own-ship visits 4 to 9 cells. Slots are re-bucketed on every update
+ * and dead-reckoning step that moves them into another cell.
+ */
+#define TRAFFIC_GRID_CELL           (2 * ALARM_ZONE_NONE) /* metres */
+#if MAX_TRACKING_OBJECTS > 64
+#define TRAFFIC_GRID_BUCKETS        1024  /* power of two */
+#else
+#define TRAFFIC_GRID_BUCKETS        16
+#endif
+
+/*
+ * Fusion of one aircraft heard over several protocols: tracks are associated
+ * by address (ICAO addresses are the same on every protocol) or by gating
+ * of position and velocity, and each field is taken from its best source
+ * that is still fresh. A gated alias is fused after TRAFFIC_FUSION_CONFIRM
+ * agreeing updates in a row, re-checked on every one of its updates
+ * and dropped on the first one that disagrees.
+ */
+#define TRAFFIC_FUSION_GATE_H       100 /* metres */
+#define TRAFFIC_FUSION_GATE_V       100 /* metres, ADS-B altitude is baro */
+#define TRAFFIC_FUSION_GATE_SPEED   5   /* m/s */
+#define TRAFFIC_FUSION_GATE_TRACK   30  /* degrees, above the speed below */
+#define TRAFFIC_FUSION_MIN_SPEED    5   /* m/s, the track is noise below */
+#define TRAFFIC_FUSION_CONFIRM      3   /* agreeing updates in a row */
+#define TRAFFIC_FUSION_HOLD         3   /* seconds a better source is kept */
 #define isTimeToUpdateTraffic() (millis() - UpdateTrafficTimeMarker > \
                                   TRAFFIC_UPDATE_INTERVAL_MS)
 
+/*
+ * Delta export: a target is re-sent only when it has moved or turned
+ * noticeably, or when the refresh interval has elapsed.
+ */
+#define EXPORT_DELTA_DIST       20   /* metres */
+#define EXPORT_DELTA_ALT        10   /* metres */
+#define EXPORT_DELTA_COURSE     5    /* degrees */
+#define EXPORT_DELTA_SPEED      2    /* knots */
+#define EXPORT_DELTA_REFRESH_MS 3000 /* keep consumers from expiring targets */
+
+#define EXPORT_INTERVAL_MS(r)   (export_interval_ms[(r) < EXPORT_RATE_COUNT ? \
+                                                    (r) : EXPORT_RATE_1HZ])
+
 enum
 {
 	TRAFFIC_ALARM_NONE,
 	TRAFFIC_ALARM_DISTANCE,
 	TRAFFIC_ALARM_VECTOR,
-	TRAFFIC_ALARM_LEGACY
+	TRAFFIC_ALARM_LEGACY,
+	TRAFFIC_ALARM_TURN
+};
+
+enum
+{
+	EXPORT_RATE_1HZ,
+	EXPORT_RATE_2HZ,
+	EXPORT_RATE_5HZ,
+	EXPORT_RATE_10HZ,
+	EXPORT_RATE_0_5HZ,
+	EXPORT_RATE_0_2HZ,
+	EXPORT_RATE_COUNT
+};
+
+enum
+{
+	TRAFFIC_FIELD_POSITION,
+	TRAFFIC_FIELD_ALTITUDE,
+	TRAFFIC_FIELD_BARO,
+	TRAFFIC_FIELD_CLIMB,
+	TRAFFIC_FIELD_COUNT
+};
+
+typedef struct traffic_fusion_struct {
+  uint32_t  alias;      /* address of the same aircraft on another protocol */
+  uint8_t   alias_protocol;
+  uint8_t   alias_hits; /* agreeing updates of the alias in a row */
+  bool      fused;      /* alias confirmed, its updates go into this track */
+  uint8_t   source[TRAFFIC_FIELD_COUNT];  /* protocol that provided a field */
+  time_t    time[TRAFFIC_FIELD_COUNT];
+} traffic_fusion_t;
+
+/*
+ * Hot fields of the targets, structure-of-arrays, as processed by
+ * Traffic_Geometry() in straight loops without calls or branches
+ */
+typedef struct traffic_hot_struct {
+  int       count;
+  float     *dlat;        /* degrees from own-ship */
+  float     *dlon;
+  float     *dalt;        /* metres above own-ship */
+  float     *north;       /* metres */
+  float     *east;
+  float     *distance;
+  float     *bearing;
+  int8_t    *alarm_level; /* distance alarm only */
+} traffic_hot_t;
+
+enum
+{
+	EXPORT_SINK_NMEA,
+	EXPORT_SINK_GDL90,
+	EXPORT_SINK_D1090,
+	EXPORT_SINK_JSON,
+	EXPORT_SINK_COUNT
 };
 
 void ParseData(void);
@@ -48,7 +180,19 @@ void Traffic_setup(void);
 void Traffic_loop(void);
 void ClearExpired(void);
 void Traffic_Update(int);
+void Traffic_UpdateAll(void);
+void Traffic_Geometry(traffic_hot_t *);
+void Traffic_Rank(int);
+void Traffic_Clear(int);
+int  Traffic_Add(ufo_t *);
+int  Traffic_Query_Box(float, float, float, float, int *, int);
+int  Traffic_Query_Radius(float, float, int *, int);
+bool Traffic_NeedsExport(int, uint8_t);
 
 extern ufo_t fo, Container[MAX_TRACKING_OBJECTS], EmptyFO;
+extern uint16_t Traffic_Ranking[MAX_TRACKING_OBJECTS];
+extern uint16_t Traffic_Ranked;
+extern traffic_fusion_t Traffic_Fusion[MAX_TRACKING_OBJECTS];
+extern const uint16_t export_interval_ms[EXPORT_RATE_COUNT];
 
 #endif /* TRAFFICHELPER_H */
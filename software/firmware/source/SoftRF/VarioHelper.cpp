@@ -0,0 +1,60 @@
+/*
+ * VarioHelper.cpp
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VarioHelper.h"
+
+vario_t Vario = { false, 0, 0, 0 };
+
+/* pressure altitude in cm, sampled at 'ms' */
+void Vario_Baro(unsigned long ms, int32_t altitude)
+{
+  unsigned long dt = ms - Vario.ms;
+
+  if (!Vario.valid || dt > VARIO_RESET_MS) {
+    Vario.valid    = true;
+    Vario.ms       = ms;
+    Vario.altitude = altitude;
+    Vario.climb    = 0;
+    return;
+  }
+
+  if (dt == 0) {
+    return;
+  }
+
+  /* predict */
+  Vario.altitude += (Vario.climb * (int32_t) dt) / 1000;
+
+  /* correct */
+  int32_t residual = altitude - Vario.altitude;
+
+  if (residual >  VARIO_RESIDUAL_MAX) residual =  VARIO_RESIDUAL_MAX;
+  if (residual < -VARIO_RESIDUAL_MAX) residual = -VARIO_RESIDUAL_MAX;
+
+  Vario.altitude += (residual * VARIO_K_H) / 256;
+  Vario.climb    += (residual * VARIO_K_V * 1000) / (256 * (int32_t) dt);
+  Vario.ms        = ms;
+}
+
+/* GNSS vertical velocity in cm/s, up is positive */
+void Vario_GNSS(int32_t climb)
+{
+  if (Vario.valid) {
+    Vario.climb += ((climb - Vario.climb) * VARIO_K_GNSS) / 256;
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * VarioHelper.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VARIOHELPER_H
+#define VARIOHELPER_H
+
+#include <stdint.h>
+
+/*
+ * Pressure altitude and climb rate from baro samples taken at any rate,
+ * blended with GNSS vertical velocity where the receiver provides one.
+ * An alpha-beta filter in integer cm and cm/s, a fixed handful of
+ * multiplications per sample. Gains are in 1/256 units and are tuned
+ * for 4 to 10 baro samples per second.
+ */
+#define VARIO_K_H         90    /* baro altitude correction,  0.35  */
+#define VARIO_K_V         20    /* baro climb correction,     0.08  */
+#define VARIO_K_GNSS      64    /* GNSS climb blending,       0.25  */
+#define VARIO_RESET_MS    2000  /* a longer gap between baro samples restarts */
+#define VARIO_RESIDUAL_MAX 10000 /* cm */
+#define VARIO_DEADBAND    10    /* cm/s, smaller climb rates read as zero */
+
+typedef struct vario_struct {
+  bool          valid;
+  unsigned long ms;         /* time of the latest baro sample */
+  int32_t       altitude;   /* cm, pressure altitude */
+  int32_t       climb;      /* cm/s */
+} vario_t;
+
+void Vario_Baro(unsigned long, int32_t);
+void Vario_GNSS(int32_t);
+
+extern vario_t Vario;
+
+#endif /* VARIOHELPER_H */
@@ -30,6 +30,10 @@
 #include "NMEAHelper.h"
 #include "GDL90Helper.h"
 #include "D1090Helper.h"
+#include "TrackHelper.h"
+#include "LatencyHelper.h"
+#include "MetricsHelper.h"
+#include "LinkHelper.h"
 
 #if defined(ENABLE_AHRS)
 #include "AHRSHelper.h"
@@ -114,9 +118,42 @@ Copyright (C) 2015-2019 &nbsp;&nbsp;&nbsp; Linar Yusupov\
 </body>\
 </html>";
 
+/* slowest first, as offered by every export rate select */
+static const struct {
+  uint8_t     rate;
+  const char *label;
+} Export_Rates[] = {
+  { EXPORT_RATE_0_2HZ, "0.2 Hz" },
+  { EXPORT_RATE_0_5HZ, "0.5 Hz" },
+  { EXPORT_RATE_1HZ,   "1 Hz"   },
+  { EXPORT_RATE_2HZ,   "2 Hz"   },
+  { EXPORT_RATE_5HZ,   "5 Hz"   },
+  { EXPORT_RATE_10HZ,  "10 Hz"  },
+};
+
+static size_t Export_Rate_Select(char *buf, size_t size, const char *title,
+                                 const char *name, uint8_t rate)
+{
+  size_t len = snprintf(buf, size, "<tr><th align=left>%s</th>"
+                                   "<td align=right><select name='%s'>",
+                        title, name);
+
+  for (size_t i = 0; i < sizeof(Export_Rates) / sizeof(Export_Rates[0]) &&
+                  len < size; i++) {
+    len += snprintf(buf + len, size - len, "<option %s value='%d'>%s</option>",
+                    (rate == Export_Rates[i].rate ? "selected" : ""),
+                    Export_Rates[i].rate, Export_Rates[i].label);
+  }
+  if (len < size) {
+    len += snprintf(buf + len, size - len, "</select></td></tr>");
+  }
+
+  return len < size ? len : size - 1;
+}
+
 void handleSettings() {
 
-  size_t size = 4700;
+  size_t size = 7000;
   char *offset;
   size_t len = 0;
   char *Settings_temp = (char *) malloc(size);
@@ -242,6 +279,8 @@ void handleSettings() {
 <option %s value='%d'>None</option>\
 <option %s value='%d'>Distance</option>\
 <option %s value='%d'>Vector</option>\
+<option %s value='%d'>Legacy</option>\
+<option %s value='%d'>Turn</option>\
 </select>\
 </td>\
 </tr>\
@@ -295,6 +334,8 @@ void handleSettings() {
   (settings->alarm == TRAFFIC_ALARM_NONE ? "selected" : ""),  TRAFFIC_ALARM_NONE,
   (settings->alarm == TRAFFIC_ALARM_DISTANCE ? "selected" : ""),  TRAFFIC_ALARM_DISTANCE,
   (settings->alarm == TRAFFIC_ALARM_VECTOR ? "selected" : ""),  TRAFFIC_ALARM_VECTOR,
+  (settings->alarm == TRAFFIC_ALARM_LEGACY ? "selected" : ""),  TRAFFIC_ALARM_LEGACY,
+  (settings->alarm == TRAFFIC_ALARM_TURN ? "selected" : ""),  TRAFFIC_ALARM_TURN,
   (settings->txpower == RF_TX_POWER_FULL ? "selected" : ""),  RF_TX_POWER_FULL,
   (settings->txpower == RF_TX_POWER_LOW ? "selected" : ""),  RF_TX_POWER_LOW,
   (settings->txpower == RF_TX_POWER_OFF ? "selected" : ""),  RF_TX_POWER_OFF,
@@ -470,6 +511,46 @@ void handleSettings() {
     PSTR("\
 </select>\
 </td>\
+</tr>"));
+
+  len = strlen(offset);
+  offset += len;
+  size -= len;
+
+  /* each sink keeps a pace of its own */
+  len = Export_Rate_Select(offset, size, "NMEA rate", "nmea_rate",
+                           settings->nmea_rate);
+  offset += len;
+  size -= len;
+  len = Export_Rate_Select(offset, size, "GDL90 rate", "gdl90_rate",
+                           settings->gdl90_rate);
+  offset += len;
+  size -= len;
+  len = Export_Rate_Select(offset, size, "Dump1090 rate", "d1090_rate",
+                           settings->d1090_rate);
+  offset += len;
+  size -= len;
+  len = Export_Rate_Select(offset, size, "JSON rate", "json_rate",
+                           settings->json_rate);
+  offset += len;
+  size -= len;
+
+  /* Common part 7 */
+  snprintf_P ( offset, size,
+    PSTR("\
+<tr>\
+<th align=left>Delta export</th>\
+<td align=right>\
+<input type='radio' name='export_delta' value='0' %s>Off\
+<input type='radio' name='export_delta' value='1' %s>On\
+</td>\
+</tr>\
+<tr>\
+<th align=left>GNSS input</th>\
+<td align=right>\
+<input type='radio' name='gnss_pvt' value='0' %s>NMEA\
+<input type='radio' name='gnss_pvt' value='1' %s>UBX PVT\
+</td>\
 </tr>\
 <tr>\
 <th align=left>Power save</th>\
@@ -499,6 +580,8 @@ void handleSettings() {
 </form>\
 </body>\
 </html>"),
+  (!settings->export_delta ? "checked" : "") , (settings->export_delta ? "checked" : ""),
+  (!settings->gnss_pvt ? "checked" : "") , (settings->gnss_pvt ? "checked" : ""),
   (settings->power_save == POWER_SAVE_NONE ? "selected" : ""), POWER_SAVE_NONE,
   (settings->power_save == POWER_SAVE_WIFI ? "selected" : ""), POWER_SAVE_WIFI,
   (!settings->stealth ? "checked" : "") , (settings->stealth ? "checked" : ""),
@@ -523,13 +606,15 @@ void handleRoot() {
   bool low_voltage = (Battery_voltage() <= Battery_threshold());
 
   time_t timestamp = ThisAircraft.timestamp;
-  unsigned int sats = gnss.satellites.value(); // Number of satellites in use (u32)
+  unsigned int sats = GNSS_Decoded.source ? GNSS_Decoded.sats :
+                      gnss.satellites.value(); // Number of satellites in use (u32)
   char str_lat[16];
   char str_lon[16];
   char str_alt[16];
   char str_Vcc[8];
+  char str_turn[8];
 
-  char *Root_temp = (char *) malloc(2300);
+  char *Root_temp = (char *) malloc(3000);
   if (Root_temp == NULL) {
     return;
   }
@@ -538,8 +623,9 @@ void handleRoot() {
   dtostrf(ThisAircraft.longitude, 8, 4, str_lon);
   dtostrf(ThisAircraft.altitude, 7, 1, str_alt);
   dtostrf(vdd, 4, 2, str_Vcc);
+  dtostrf(Track_TurnRate(), 5, 1, str_turn);
 
-  snprintf_P ( Root_temp, 2300,
+  snprintf_P ( Root_temp, 3000,
     PSTR("<html>\
   <head>\
     <meta name='viewport' content='width=device-width, initial-scale=1'>\
@@ -571,11 +657,16 @@ void handleRoot() {
   <tr><th align=left>Battery voltage</th><td align=right><font color=%s>%s</font></td></tr>\
  </table>\
  <table width=100%%>\
-   <tr><th align=left>Packets</th>\
+   <tr><td align=left><b>Packets</b>&nbsp;&nbsp;<a href='/link'>(link quality)</a></td>\
     <td align=right><table><tr>\
      <th align=left>Tx&nbsp;&nbsp;</th><td align=right>%u</td>\
      <th align=left>&nbsp;&nbsp;&nbsp;&nbsp;Rx&nbsp;&nbsp;</th><td align=right>%u</td>\
    </tr></table></td></tr>\
+   <tr><td align=left><b>Latency</b>&nbsp;&nbsp;(ms, median/95%%)</td>\
+    <td align=right><table><tr>\
+     <th align=left>Rx to export&nbsp;&nbsp;</th><td align=right>%u/%u</td>\
+     <th align=left>&nbsp;&nbsp;&nbsp;&nbsp;Loop&nbsp;&nbsp;</th><td align=right>%u/%u</td>\
+   </tr></table></td></tr>\
  </table>\
  <h2 align=center>Most recent GNSS fix</h2>\
  <table width=100%%>\
@@ -584,6 +675,8 @@ void handleRoot() {
   <tr><th align=left>Latitude</th><td align=right>%s</td></tr>\
   <tr><th align=left>Longitude</th><td align=right>%s</td></tr>\
   <tr><td align=left><b>Altitude</b>&nbsp;&nbsp;(above MSL)</td><td align=right>%s</td></tr>\
+  <tr><td align=left><b>Track history</b>&nbsp;&nbsp;(samples)</td><td align=right>%d</td></tr>\
+  <tr><td align=left><b>Turn rate</b>&nbsp;&nbsp;(deg/s)</td><td align=right>%s</td></tr>\
  </table>\
  <hr>\
  <table width=100%%>\
@@ -610,7 +703,12 @@ void handleRoot() {
     hr, min % 60, sec % 60, ESP.getFreeHeap(),
     low_voltage ? "red" : "green", str_Vcc,
     tx_packets_counter, rx_packets_counter,
-    timestamp, sats, str_lat, str_lon, str_alt
+    Latency_Percentile(LATENCY_EXPORT, 50) / 1000,
+    Latency_Percentile(LATENCY_EXPORT, 95) / 1000,
+    Latency_Percentile(LATENCY_LOOP, 50) / 1000,
+    Latency_Percentile(LATENCY_LOOP, 95) / 1000,
+    timestamp, sats, str_lat, str_lon, str_alt,
+    Track_Count(), str_turn
   );
   SoC->swSer_enableRx(false);
   server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
@@ -623,7 +721,7 @@ void handleRoot() {
 
 void handleInput() {
 
-  char *Input_temp = (char *) malloc(1520);
+  char *Input_temp = (char *) malloc(1900);
   if (Input_temp == NULL) {
     return;
   }
@@ -667,9 +765,21 @@ void handleInput() {
       settings->no_track = server.arg(i).toInt();
     } else if (server.argName(i).equals("power_save")) {
       settings->power_save = server.arg(i).toInt();
+    } else if (server.argName(i).equals("nmea_rate")) {
+      settings->nmea_rate = server.arg(i).toInt();
+    } else if (server.argName(i).equals("gdl90_rate")) {
+      settings->gdl90_rate = server.arg(i).toInt();
+    } else if (server.argName(i).equals("d1090_rate")) {
+      settings->d1090_rate = server.arg(i).toInt();
+    } else if (server.argName(i).equals("json_rate")) {
+      settings->json_rate = server.arg(i).toInt();
+    } else if (server.argName(i).equals("export_delta")) {
+      settings->export_delta = server.arg(i).toInt();
+    } else if (server.argName(i).equals("gnss_pvt")) {
+      settings->gnss_pvt = server.arg(i).toInt();
     }
   }
-  snprintf_P ( Input_temp, 1520,
+  snprintf_P ( Input_temp, 1900,
 PSTR("<html>\
 <head>\
 <meta http-equiv='refresh' content='15; url=/'>\
@@ -698,6 +808,12 @@ PSTR("<html>\
 <tr><th align=left>Stealth</th><td align=right>%s</td></tr>\
 <tr><th align=left>No track</th><td align=right>%s</td></tr>\
 <tr><th align=left>Power save</th><td align=right>%d</td></tr>\
+<tr><th align=left>NMEA rate</th><td align=right>%d</td></tr>\
+<tr><th align=left>GDL90 rate</th><td align=right>%d</td></tr>\
+<tr><th align=left>Dump1090 rate</th><td align=right>%d</td></tr>\
+<tr><th align=left>JSON rate</th><td align=right>%d</td></tr>\
+<tr><th align=left>Delta export</th><td align=right>%s</td></tr>\
+<tr><th align=left>GNSS input</th><td align=right>%s</td></tr>\
 </table>\
 <hr>\
   <p align=center><h1 align=center>Restart is in progress... Please, wait!</h1></p>\
@@ -710,7 +826,9 @@ PSTR("<html>\
   BOOL_STR(settings->nmea_l), BOOL_STR(settings->nmea_s),
   settings->nmea_out, settings->gdl90, settings->d1090,
   BOOL_STR(settings->stealth), BOOL_STR(settings->no_track),
-  settings->power_save
+  settings->power_save, settings->nmea_rate, settings->gdl90_rate,
+  settings->d1090_rate, settings->json_rate, BOOL_STR(settings->export_delta),
+  settings->gnss_pvt ? "UBX PVT" : "NMEA"
   );
   SoC->swSer_enableRx(false);
   server.send ( 200, "text/html", Input_temp );
@@ -723,6 +841,112 @@ PSTR("<html>\
   ESP.restart();
 }
 
+/* "/metrics" is Prometheus text, "/metrics.json" the same in JSON */
+void handleMetrics() {
+
+  bool json = server.uri().endsWith(".json");
+
+  size_t size = (json ? Metrics_JSON(NULL, 0) : Metrics_Text(NULL, 0)) +
+                METRICS_SLACK;
+  char *Metrics_temp = (char *) malloc(size);
+  if (Metrics_temp == NULL) {
+    return;
+  }
+
+  size_t len = json ? Metrics_JSON(Metrics_temp, size) :
+                      Metrics_Text(Metrics_temp, size);
+  if (len >= size) {
+    Serial.print(F("Metrics truncated to "));
+    Serial.print(size - 1);
+    Serial.print(F(" of "));
+    Serial.print(len);
+    Serial.println(F(" bytes"));
+  }
+
+  SoC->swSer_enableRx(false);
+  server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
+  server.send ( 200, json ? "application/json" : "text/plain; version=0.0.4", Metrics_temp );
+  SoC->swSer_enableRx(true);
+  free(Metrics_temp);
+}
+
+/* reception of every aircraft heard, and the range curves */
+void handleLink() {
+
+  size_t len = 0;
+
+  char *Link_temp = (char *) malloc(LINK_PAGE_SIZE);
+  if (Link_temp == NULL) {
+    return;
+  }
+
+  len += snprintf_P(Link_temp + len, LINK_PAGE_SIZE - len,
+    PSTR("<html>\
+  <head>\
+    <meta name='viewport' content='width=device-width, initial-scale=1'>\
+    <meta http-equiv='refresh' content='5'>\
+    <title>SoftRF link quality</title>\
+  </head>\
+<body>\
+ <h1 align=center>Link quality</h1>\
+ <table width=100%%>\
+  <tr><th align=left>Aircraft</th><th align=right>Distance (m)</th>\
+   <th align=right>RSSI (dBm)</th><th align=right>Packets/min</th>\
+   <th align=right>Loss (%%)</th><th align=right>Max. gap (ms)</th>\
+   <th align=right>Corrected</th></tr>"));
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS && len < LINK_PAGE_SIZE; i++) {
+    if (Container[i].addr && Link_Stats[i].addr == Container[i].addr) {
+      len += snprintf_P(Link_temp + len, LINK_PAGE_SIZE - len,
+        PSTR("<tr><td align=left>%06X</td><td align=right>%u</td>\
+<td align=right>%d</td><td align=right>%u</td><td align=right>%u</td>\
+<td align=right>%u</td><td align=right>%u</td></tr>"),
+        Container[i].addr, (unsigned int) Container[i].distance,
+        Link_Rssi(i), Link_Rate(i), Link_Loss(i),
+        Link_Stats[i].gap_max, Link_Stats[i].corrected);
+    }
+  }
+
+  for (uint8_t p=0; p < LINK_PROTOCOLS && len < LINK_PAGE_SIZE; p++) {
+    const rf_proto_desc_t *rf = RF_Protocol_Desc(p);
+
+    if (rf == NULL || Link_Range_Max(p) == 0) {
+      continue;
+    }
+
+    len += snprintf_P(Link_temp + len, LINK_PAGE_SIZE - len,
+      PSTR("</table><h2 align=center>%s range, up to %u m</h2>\
+ <table width=100%%>\
+  <tr><th align=left>Distance (m)</th><th align=right>Packets</th>\
+   <th align=right>Mean RSSI (dBm)</th></tr>"),
+      rf->name, Link_Range_Max(p));
+
+    for (uint8_t b=0; b < LINK_RANGE_BINS && len < LINK_PAGE_SIZE; b++) {
+      link_range_t *lr = &Link_Range[p][b];
+
+      if (lr->count) {
+        len += snprintf_P(Link_temp + len, LINK_PAGE_SIZE - len,
+          PSTR("<tr><td align=left>%s%u</td><td align=right>%u</td>\
+<td align=right>%d</td></tr>"),
+          b < LINK_RANGE_BINS - 1 ? "&lt;&nbsp;" : "&ge;&nbsp;",
+          (unsigned int) LINK_RANGE_FIRST << (b < LINK_RANGE_BINS - 1 ? b : b - 1),
+          lr->count, (int) (lr->rssi_sum / (int32_t) lr->count));
+      }
+    }
+  }
+
+  if (len < LINK_PAGE_SIZE) {
+    snprintf_P(Link_temp + len, LINK_PAGE_SIZE - len,
+      PSTR("</table></body></html>"));
+  }
+
+  SoC->swSer_enableRx(false);
+  server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
+  server.send ( 200, "text/html", Link_temp );
+  SoC->swSer_enableRx(true);
+  free(Link_temp);
+}
+
 void handleNotFound() {
 
   String message = "File Not Found\n\n";
@@ -755,6 +979,9 @@ void Web_setup()
   } );
 
   server.on ( "/input", handleInput );
+  server.on ( "/metrics", handleMetrics );
+  server.on ( "/metrics.json", handleMetrics );
+  server.on ( "/link", handleLink );
   server.on ( "/inline", []() {
     server.send ( 200, "text/plain", "this works as well" );
   } );
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# check.sh
+# Replays every test/<scene>.log and compares each captured output
+# with its expected copy, test/<scene>.<output>, where one is present.
+# GDL90 captures are also decoded by test/gdl90_decode, when built,
+# into test/<scene>.gdl90.txt.
+#
+# Usage: test/check.sh [-u] [path to SoftRF binary]
+#   -u  update the expected outputs from this run instead
+#
+
+UPDATE=0
+if [ "$1" = "-u" ]; then
+  UPDATE=1
+  shift
+fi
+
+BIN=${1:-./SoftRF}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+FAIL=0
+
+for LOG in "$DIR"/*.log; do
+  SCENE=$(basename "$LOG" .log)
+  DIFF=0
+
+  if ! "$BIN" -r "$LOG" -s 0 -o "$TMP/$SCENE" > /dev/null 2>&1; then
+    echo "FAIL $SCENE: replay failed"
+    FAIL=1
+    continue
+  fi
+
+  # GDL90 as an independent decoder reads it
+  if [ -s "$TMP/$SCENE.gdl90" ] && [ -x "$DIR/gdl90_decode" ]; then
+    if ! "$DIR/gdl90_decode" "$TMP/$SCENE.gdl90" > "$TMP/$SCENE.gdl90.txt" \
+         2> /dev/null; then
+      echo "FAIL $SCENE: malformed GDL90"
+      DIFF=1
+    fi
+  fi
+
+  for OUT in "$TMP/$SCENE".*; do
+    EXPECTED="$DIR/$(basename "$OUT")"
+
+    if [ $UPDATE -eq 1 ]; then
+      if [ -s "$OUT" ]; then
+        cp "$OUT" "$EXPECTED"
+      else
+        rm -f "$EXPECTED"
+      fi
+    elif [ -f "$EXPECTED" ] || [ -s "$OUT" ]; then
+      if ! cmp -s "$OUT" "$EXPECTED"; then
+        echo "FAIL $SCENE: $(basename "$OUT") differs"
+        DIFF=1
+      fi
+    fi
+  done
+
+  if [ $DIFF -eq 1 ]; then
+    FAIL=1
+  elif [ $UPDATE -eq 0 ]; then
+    echo "PASS $SCENE"
+  fi
+done
+
+exit $FAIL
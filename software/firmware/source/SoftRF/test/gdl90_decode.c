@@ -0,0 +1,158 @@
+/*
+ * gdl90_decode.c
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decodes a GDL90 capture of SoftRF with the independent decoder of
+ * libraries/rotobox and prints one line per message.
+ * Exits with 1 when a frame is malformed or fails its FCS.
+ */
+
+#include "gdl90.h"
+
+static int frames, errors;
+
+static void print_report(const char *name, gdl_message_t *msg)
+{
+  gdl90_msg_traffic_report_t r;
+
+  decode_gdl90_traffic_report(msg, &r);
+  printf("%s %06X type %d alert %d lat %.5f lon %.5f alt %.0f ft %s "
+         "track %.1f speed %.0f kt vs %.0f fpm emitter %d callsign %.8s\n",
+         name, r.address, r.addressType, r.trafficAlertStatus,
+         r.latitude, r.longitude, r.altitude,
+         r.airborne ? "airborne" : "ground",
+         r.trackOrHeading, r.horizontalVelocity, r.verticalVelocity,
+         r.emitterCategory, r.callsign);
+}
+
+static void frame(uint8_t *buf, int len)
+{
+  gdl_message_t msg;
+  int size = 0;
+
+  /* undo the byte stuffing */
+  for (int i = 0; i < len; i++) {
+    uint8_t c = buf[i];
+
+    if (c == GDL90_CONTROL_ESCAPE && i + 1 < len) {
+      c = buf[++i] ^ GDL90_ESCAPE_BYTE;
+    } else if (c == GDL90_CONTROL_ESCAPE) {
+      printf("error: escape at the end of a frame\n");
+      errors++;
+      return;
+    }
+    if (size >= (int) sizeof(msg) - 1) {
+      printf("error: frame too long\n");
+      errors++;
+      return;
+    }
+    ((uint8_t *) &msg.messageId)[size++] = c;
+  }
+
+  frames++;
+
+  /* message id, payload and 2 bytes of FCS */
+  int payload = size - 3;
+
+  if (payload < 0) {
+    printf("error: frame of %d bytes\n", size);
+    errors++;
+    return;
+  }
+  if (!gdl90_verifyCrc(&msg, payload)) {
+    printf("error: FCS of message %d\n", msg.messageId);
+    errors++;
+    return;
+  }
+
+  switch (msg.messageId)
+  {
+  case MSG_ID_HEARTBEAT:
+    if (payload != GDL90_MSG_LEN_HEARTBEAT) break;
+    /* the time stamp is LSB first, as per the ICD */
+    printf("heartbeat gps %d uat %d time %u\n",
+           msg.data[0] >> 7, msg.data[0] & 1,
+           ((msg.data[1] >> 7) << 16) | (msg.data[3] << 8) | msg.data[2]);
+    return;
+  case MSG_ID_OWNSHIP_REPORT:
+    if (payload != GDL90_MSG_LEN_OWNSHIP_REPORT) break;
+    print_report("ownship", &msg);
+    return;
+  case MSG_ID_TRAFFIC_REPORT:
+    if (payload != GDL90_MSG_LEN_TRAFFIC_REPORT) break;
+    print_report("traffic", &msg);
+    return;
+  case MSG_ID_OWNSHIP_GEOMETRIC:
+    if (payload != GDL90_MSG_LEN_OWNSHIP_GEOMETRIC) break;
+    {
+      gdl90_msg_ownship_geo_altitude g;
+
+      decode_gdl90_ownship_geo_altitude(&msg, &g);
+      printf("geo_altitude %.0f ft\n", g.ownshipGeoAltitude);
+    }
+    return;
+  default:
+    printf("message %d of %d bytes\n", msg.messageId, payload);
+    return;
+  }
+
+  printf("error: message %d of %d bytes\n", msg.messageId, payload);
+  errors++;
+}
+
+int main(int argc, char *argv[])
+{
+  static uint8_t buf[2 * sizeof(gdl_message_t)];
+  FILE *f;
+  int c, len = 0;
+  int open = 0;
+
+  if (argc != 2 || (f = fopen(argv[1], "rb")) == NULL) {
+    fprintf(stderr, "Usage: %s capture.gdl90\n", argv[0]);
+    return 2;
+  }
+
+  gdl90_crcInit();
+
+  while ((c = fgetc(f)) != EOF) {
+    if (c == GDL90_FLAG_BYTE) {
+      if (open && len > 0) {
+        frame(buf, len);
+        open = 0;
+      } else {
+        open = 1;
+      }
+      len = 0;
+    } else if (!open) {
+      printf("error: data out of a frame\n");
+      errors++;
+    } else if (len < (int) sizeof(buf)) {
+      buf[len++] = c;
+    }
+  }
+  fclose(f);
+
+  if (open && len > 0) {
+    printf("error: truncated frame\n");
+    errors++;
+  }
+
+  fprintf(stderr, "%d frames, %d errors\n", frames, errors);
+
+  return errors ? 1 : 0;
+}
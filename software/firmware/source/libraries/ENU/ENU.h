@@ -0,0 +1,82 @@
+/*
+ * ENU.h
+ * Copyright (C) 2019 Linar Yusupov
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENU_H
+#define ENU_H
+
+#include <math.h>
+
+/*
+ * Local east-north frame, shared by SoftRF and SkyView: distance and bearing
+ * to targets are taken on a plane tangent to the sphere near own-ship.
+ * Within 20 km the distance error against the great-circle value is below
+ * 0.003% (0.6 m) up to 80 degrees latitude; the bearing differs from the
+ * initial great-circle course by meridian convergence only, 0.1 degree at 45
+ * and 0.25 degree at 70 degrees.
+ */
+#define ENU_EARTH_RADIUS            6372795.0 /* metres, same as TinyGPS++ */
+#define ENU_ANCHOR_THRESHOLD        0.1       /* degrees of latitude */
+
+/*
+ * Scale factors of the frame. They depend on latitude only
+ * and are refreshed when own-ship drifts by more than ENU_ANCHOR_THRESHOLD.
+ */
+typedef struct enu_anchor_struct {
+  bool  valid;
+  float latitude;
+  float m_per_deg_lat;
+  float m_per_deg_lon;
+  float tan_lat;      /* first order correction of m_per_deg_lon */
+} enu_anchor_t;
+
+static inline void ENU_Anchor_Update(enu_anchor_t *anchor, float latitude)
+{
+  if (!anchor->valid ||
+      fabsf(latitude - anchor->latitude) > ENU_ANCHOR_THRESHOLD) {
+    anchor->latitude      = latitude;
+    anchor->m_per_deg_lat = radians(ENU_EARTH_RADIUS);
+    anchor->m_per_deg_lon = anchor->m_per_deg_lat *
+                            cosf(radians(anchor->latitude));
+    anchor->tan_lat       = tanf(radians(anchor->latitude));
+    anchor->valid         = true;
+  }
+}
+
+/* offsets in metres of (lat, lon) from own-ship at (ref_lat, ref_lon) */
+static inline void ENU_Project(enu_anchor_t *anchor,
+                               float ref_lat, float ref_lon,
+                               float lat, float lon,
+                               float *east, float *north)
+{
+  ENU_Anchor_Update(anchor, ref_lat);
+
+  float dlat = lat - ref_lat;
+  float dlon = lon - ref_lon;
+
+  if (dlon >  180.0) dlon -= 360.0;
+  if (dlon < -180.0) dlon += 360.0;
+
+  /* longitude scale at the mean latitude of the two points */
+  float mid = ref_lat + dlat * 0.5 - anchor->latitude;
+
+  *north = dlat * anchor->m_per_deg_lat;
+  *east  = dlon * anchor->m_per_deg_lon *
+           (1.0 - anchor->tan_lat * radians(mid));
+}
+
+#endif /* ENU_H */
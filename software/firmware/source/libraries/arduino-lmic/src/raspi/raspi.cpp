@@ -155,9 +155,21 @@ void initialiseEpoch() {
   digitalWrite(lmic_pins.nss, HIGH);
 }
 
+// Replays run on a simulated clock, set from outside
+static bool     simClock = false ;
+static uint32_t simMilli = 0 ;
+
+void simulateClock(unsigned int ms) {
+  simClock = true ;
+  simMilli = ms ;
+}
+
 unsigned int millis() {
   struct timeval tv ;
   uint64_t now ;
+  if (simClock) {
+    return simMilli ;
+  }
   gettimeofday (&tv, NULL) ;
   now  = (uint64_t)tv.tv_sec * (uint64_t)1000 + (uint64_t)(tv.tv_usec / 1000) ;
   return (uint32_t)(now - epochMilli) ;
@@ -166,6 +178,9 @@ unsigned int millis() {
 unsigned int micros() {
   struct timeval tv ;
   uint64_t now ;
+  if (simClock) {
+    return simMilli * 1000 ;
+  }
   gettimeofday (&tv, NULL) ;
   now  = (uint64_t)tv.tv_sec * (uint64_t)1000000 + (uint64_t)tv.tv_usec ;
   return (uint32_t)(now - epochMicro) ;
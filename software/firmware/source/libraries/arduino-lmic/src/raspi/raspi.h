@@ -237,6 +237,7 @@ unsigned char digitalRead(unsigned char) ;
 void          initialiseEpoch();
 unsigned int  millis();
 unsigned int  micros();
+void          simulateClock(unsigned int);
 
 #ifdef __cplusplus
 }